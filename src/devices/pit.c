@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /* Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /* Counter port. */
 
-/* PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /* Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -46,7 +43,6 @@ void
 pit_configure_channel (int channel, int mode, int frequency)
 {
   uint16_t count;
-  enum intr_level old_level;
 
   ASSERT (channel == 0 || channel == 2);
   ASSERT (mode == 2 || mode == 3);
@@ -74,6 +70,22 @@ pit_configure_channel (int channel, int mode, int frequency)
   else
     count = (PIT_HZ + frequency / 2) / frequency;
 
+  pit_set_count (channel, mode, count);
+}
+
+/* Configures CHANNEL in the PIT to run in MODE with a period of
+   COUNT PIT cycles, as for pit_configure_channel().  COUNT must
+   be between 2 and 65536, or 0 for 65536.  The new period starts
+   immediately. */
+void
+pit_set_count (int channel, int mode, unsigned count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (mode == 2 || mode == 3);
+  ASSERT (count != 1 && count <= 65536);
+
   /* Configure the PIT mode and load its counters. */
   old_level = intr_disable ();
   outb (PIT_PORT_CONTROL, (channel << 6) | 0x30 | (mode << 1));
@@ -81,3 +93,23 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/* Returns the number of PIT cycles left in CHANNEL's current
+   period. */
+unsigned
+pit_read_count (int channel)
+{
+  enum intr_level old_level;
+  unsigned count;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  /* Latch the counter, then read it a byte at a time. */
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, channel << 6);
+  count = inb (PIT_PORT_COUNTER (channel));
+  count |= inb (PIT_PORT_COUNTER (channel)) << 8;
+  intr_set_level (old_level);
+
+  return count != 0 ? count : 65536;
+}
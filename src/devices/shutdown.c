@@ -5,10 +5,14 @@
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "threads/io.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
 #endif
+#ifdef VM
+#include "vm/swap.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "filesys/filesys.h"
@@ -130,6 +134,7 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
 #ifdef FILESYS
   block_print_stats ();
 #endif
@@ -138,4 +143,7 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+#ifdef VM
+  swap_print_stats ();
+#endif
 }
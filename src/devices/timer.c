@@ -20,12 +20,75 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Number of timer interrupts since OS booted. */
+static int64_t interrupts;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Nanosecond clock.  Until timer_calibrate() has measured the
+   time stamp counter (TSC) against the PIT, and on CPUs without a
+   TSC, it advances a tick at a time.  After that, timer_nanos()
+   adds the TSC cycles since tsc_base, converted by multiplying by
+   ns_mult and shifting right by NS_SHIFT, to nanos_base.  The
+   shift keeps the product of a 32-bit cycle count and ns_mult
+   within 64 bits for TSCs of TSC_MIN_HZ or faster. */
+#define NS_PER_TICK (NS_PER_SEC / TIMER_FREQ)
+#define NS_SHIFT 24
+#define TSC_MIN_HZ (NS_PER_SEC / 64)
+#define TSC_CALIBRATE_TICKS (TIMER_FREQ / 10)
+static uint64_t tsc_hz;         /* TSC cycles per second, or 0. */
+static uint64_t tsc_base;       /* TSC when nanos_base was taken. */
+static int64_t nanos_base;      /* Clock value at tsc_base. */
+static uint64_t ns_mult;        /* Nanoseconds per cycle << NS_SHIFT. */
+
+/* Pending timer events are kept in a hierarchical timer wheel.
+   Level 0 has one slot per tick for the next WHEEL_SLOTS ticks.
+   Each slot of level N covers WHEEL_SLOTS times as many ticks as
+   a slot of level N - 1, and is cascaded down into the lower
+   levels when the tick count reaches the start of its range.
+   Events further away than the top level can reach wait on
+   wheel_far.  Each tick thus only touches events that expire in
+   that tick, plus an occasional cascade.  Interrupts must be off
+   to access the wheel. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 3
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static struct list wheel_far;
+static int64_t wheel_ticks;     /* Last tick whose events have run. */
+
+/* Tickless operation.
+
+   While no other thread is ready to run, the periodic tick only
+   serves to fire timer events, so timer_tick_stop() stretches
+   the PIT's period up to the next tick with work for the timer
+   wheel.  The 8254's 16-bit counter limits one period to
+   TICK_STOP_MAX ticks.  The timer interrupt that ends the
+   stretched period catches up on the ticks it covered and goes
+   back to a periodic tick.  timer_tick_start() brings it back
+   early when a thread becomes ready or an earlier event is
+   added.  Set by the "-tickless" kernel command-line option. */
+bool timer_tickless;
+
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define TICK_STOP_MAX (65536 / TICK_CYCLES)
+#define TICK_MARGIN 64          /* PIT cycles too close to call. */
+static bool tick_calibrated;    /* Set once timer_calibrate() is done. */
+static bool tick_stopped;       /* PIT period is not one tick? */
+static int64_t stop_ticks;      /* Ticks the current period covers. */
+
 static intr_handler_func timer_interrupt;
+static void wheel_place (struct timer_event *, int64_t base);
+static void wheel_cascade (struct list *, int64_t now);
+static void wheel_run (int64_t now);
+static struct list *wheel_cascade_slot (int level, int64_t now);
+static int64_t wheel_idle_ticks (int64_t max);
+static unsigned stopped_count (void);
 static bool too_many_loops (unsigned loops);
+static void tsc_calibrate (void);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
@@ -35,6 +98,13 @@ static void real_time_delay (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  int level, slot;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&wheel[level][slot]);
+  list_init (&wheel_far);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
@@ -64,6 +134,8 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  tsc_calibrate ();
+  tick_calibrated = true;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -72,6 +144,13 @@ timer_ticks (void)
 {
   enum intr_level old_level = intr_disable ();
   int64_t t = ticks;
+  if (tick_stopped)
+    {
+      /* Add the ticks the stopped period has covered so far. */
+      unsigned count = stopped_count ();
+      t += count == 0 ? stop_ticks
+                      : stop_ticks - 1 - (count - 1) / TICK_CYCLES;
+    }
   intr_set_level (old_level);
   return t;
 }
@@ -84,17 +163,62 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/* Returns the time stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Returns the number of nanoseconds since the OS booted.  The
+   value never decreases.  It has nanosecond resolution once
+   timer_calibrate() has found a time stamp counter, and
+   timer tick resolution before that or without one. */
+int64_t
+timer_nanos (void)
+{
+  uint64_t cycles;
+
+  if (tsc_hz == 0)
+    return timer_ticks () * NS_PER_TICK;
+
+  cycles = rdtsc () - tsc_base;
+  return nanos_base
+         + (int64_t) ((((cycles >> 32) * ns_mult) << (32 - NS_SHIFT))
+                      + (((cycles & 0xffffffff) * ns_mult) >> NS_SHIFT));
+}
+
+/* Timer event function that wakes up sleeping thread T_. */
+static void
+wake_thread (void *t_)
+{
+  struct thread *t = t_;
+
+  thread_unblock (t);
+  if (t->priority > thread_get_priority ())
+    intr_yield_on_return ();
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
 timer_sleep (int64_t ticks) 
 {
-    int64_t start = timer_ticks();
-    if(ticks<=0)return;//ticks should not <= 0. For robustness
+  struct timer_event wakeup;
+  enum intr_level old_level;
 
-    ASSERT(intr_get_level() == INTR_ON);
-    while (timer_elapsed(start) < ticks)
-        thread_yield();
+  if (ticks <= 0)
+    return;
+  ASSERT (intr_get_level () == INTR_ON);
+
+  timer_event_init (&wakeup, wake_thread, thread_current ());
+  old_level = intr_disable ();
+  timer_event_add (&wakeup, ticks + timer_ticks ());
+  thread_block ();
+  intr_set_level (old_level);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -164,16 +288,297 @@ timer_ndelay (int64_t ns)
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" ticks in %"PRId64" interrupts\n",
+            timer_ticks (), interrupts);
+  else
+    printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
 }
 
+/* Initializes timer event EV to call FUNC(AUX) when it fires. */
+void
+timer_event_init (struct timer_event *ev, timer_event_func *func, void *aux)
+{
+  ASSERT (ev != NULL);
+  ASSERT (func != NULL);
+
+  ev->func = func;
+  ev->aux = aux;
+  ev->pending = false;
+}
+
+/* Arranges for EV, which must not be pending, to fire in the
+   timer interrupt for tick DEADLINE, or in the next one if
+   DEADLINE has already passed.  May be called from an interrupt
+   handler, including from a timer event function. */
+void
+timer_event_add (struct timer_event *ev, int64_t deadline)
+{
+  enum intr_level old_level = intr_disable ();
+
+  ASSERT (!ev->pending);
+  ev->deadline = deadline;
+  ev->pending = true;
+  wheel_place (ev, wheel_ticks + 1);
+  if (tick_stopped && deadline < ticks + stop_ticks)
+    timer_tick_start ();
+  intr_set_level (old_level);
+}
+
+/* Cancels EV.  Returns true if it was pending, false if it had
+   already fired or was never added. */
+bool
+timer_event_cancel (struct timer_event *ev)
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = ev->pending;
+
+  if (was_pending)
+    {
+      list_remove (&ev->elem);
+      ev->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Puts EV into the wheel slot for its deadline, as seen from
+   tick BASE, the first tick whose events have not yet run. */
+static void
+wheel_place (struct timer_event *ev, int64_t base)
+{
+  int64_t deadline = ev->deadline > base ? ev->deadline : base;
+  int64_t delta = deadline - base;
+  int level;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    if (delta < (int64_t) 1 << (level + 1) * WHEEL_BITS)
+      {
+        int slot = (deadline >> level * WHEEL_BITS) & WHEEL_MASK;
+        list_push_back (&wheel[level][slot], &ev->elem);
+        return;
+      }
+  list_push_back (&wheel_far, &ev->elem);
+}
+
+/* Redistributes the events in SLOT into the wheel as of tick
+   NOW. */
+static void
+wheel_cascade (struct list *slot, int64_t now)
+{
+  struct list events;
+
+  /* Detach the slot first, since events may land in it again. */
+  list_init (&events);
+  if (!list_empty (slot))
+    list_splice (list_end (&events), list_begin (slot), list_end (slot));
+
+  while (!list_empty (&events))
+    wheel_place (list_entry (list_pop_front (&events),
+                             struct timer_event, elem), now);
+}
+
+/* Fires the timer events due at tick NOW. */
+static void
+wheel_run (int64_t now)
+{
+  struct list *slot;
+  struct list events;
+  int level;
+
+  /* Cascade every level whose current slot begins at NOW,
+     highest first, so that events reach level 0 in time. */
+  for (level = WHEEL_LEVELS; level > 0; level--)
+    {
+      slot = wheel_cascade_slot (level, now);
+      if (slot != NULL)
+        wheel_cascade (slot, now);
+    }
+
+  /* Detach the slot, since an event function may add an event
+     that belongs in it WHEEL_SLOTS ticks from now. */
+  slot = &wheel[0][now & WHEEL_MASK];
+  list_init (&events);
+  if (!list_empty (slot))
+    list_splice (list_end (&events), list_begin (slot), list_end (slot));
+  while (!list_empty (&events))
+    {
+      struct timer_event *ev = list_entry (list_pop_front (&events),
+                                           struct timer_event, elem);
+      ev->pending = false;
+      ev->func (ev->aux);
+    }
+}
+
+/* Returns the slot of level LEVEL, 1...WHEEL_LEVELS, that is due
+   to be cascaded at tick NOW, or a null pointer if there is none.
+   Level WHEEL_LEVELS stands for wheel_far. */
+static struct list *
+wheel_cascade_slot (int level, int64_t now)
+{
+  if ((now & (((int64_t) 1 << level * WHEEL_BITS) - 1)) != 0)
+    return NULL;
+  if (level == WHEEL_LEVELS)
+    return &wheel_far;
+  return &wheel[level][(now >> level * WHEEL_BITS) & WHEEL_MASK];
+}
+
+/* Returns the number of ticks after wheel_ticks until the wheel
+   has an event to fire or a slot to cascade, or MAX if that is
+   MAX ticks or more away. */
+static int64_t
+wheel_idle_ticks (int64_t max)
+{
+  int64_t n;
+
+  for (n = 1; n < max; n++)
+    {
+      int64_t now = wheel_ticks + n;
+      int level;
+
+      if (!list_empty (&wheel[0][now & WHEEL_MASK]))
+        return n;
+      for (level = 1; level <= WHEEL_LEVELS; level++)
+        {
+          struct list *slot = wheel_cascade_slot (level, now);
+          if (slot != NULL && !list_empty (slot))
+            return n;
+        }
+    }
+  return max;
+}
+
+/* Returns the PIT cycles left in the stopped period, or 0 if the
+   period has ended and its interrupt is pending. */
+static unsigned
+stopped_count (void)
+{
+  unsigned count = pit_read_count (0);
+
+  /* Check afterward, so that a period ending after the read
+     still gives a count near zero. */
+  return intr_ext_pending (0x20) ? 0 : count;
+}
+
+/* Stops the periodic tick, if tickless operation is enabled,
+   until the timer wheel next has work to do.  The caller must
+   ensure that no other thread is ready to run.  Interrupts must
+   be off. */
+void
+timer_tick_stop (void)
+{
+  int64_t n;
+  unsigned count;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || !tick_calibrated || tick_stopped)
+    return;
+
+  n = wheel_idle_ticks (TICK_STOP_MAX);
+  if (n < 2)
+    return;
+
+  /* Keep the current tick's phase: the stopped period ends N - 1
+     ticks after the current one would have. */
+  count = pit_read_count (0);
+  if (count < TICK_MARGIN || count > TICK_CYCLES
+      || intr_ext_pending (0x20))
+    return;
+  pit_set_count (0, 2, count + (n - 1) * TICK_CYCLES);
+  tick_stopped = true;
+  stop_ticks = n;
+}
+
+/* Restarts the periodic tick if it is stopped.  The ticks that
+   have passed are added to the tick count right away, and the
+   next timer interrupt arrives at the next tick boundary.
+   Interrupts must be off. */
+void
+timer_tick_start (void)
+{
+  unsigned count, rest;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!tick_stopped || stop_ticks == 1)
+    return;
+
+  /* If the period is about to end, let its interrupt do the
+     work. */
+  count = stopped_count ();
+  if (count < TICK_MARGIN)
+    return;
+
+  rest = (count - 1) / TICK_CYCLES;
+  ticks += stop_ticks - 1 - rest;
+  count -= rest * TICK_CYCLES;
+  pit_set_count (0, 2, count < 2 ? 2 : count);
+  stop_ticks = 1;
+}
+
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  ticks++;
-  
-  thread_tick ();
+  interrupts++;
+  if (tick_stopped)
+    {
+      ticks += stop_ticks;
+      tick_stopped = false;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  else
+    ticks++;
+
+  while (wheel_ticks < ticks)
+    {
+      wheel_run (++wheel_ticks);
+      thread_tick ();
+    }
+
+  if (thread_ready_count () == 0)
+    timer_tick_stop ();
+}
+
+/* Measures the TSC's frequency over TSC_CALIBRATE_TICKS timer
+   ticks and switches timer_nanos() over to it, if the CPU has a
+   TSC and it runs fast enough.  See [IA32-v2a] "CPUID--CPU
+   Identification" and "RDTSC--Read Time-Stamp Counter". */
+static void
+tsc_calibrate (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint64_t start, end, hz;
+  enum intr_level old_level;
+  int64_t t;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  if ((edx & (1u << 4)) == 0)
+    return;
+
+  /* Count cycles between two tick boundaries. */
+  t = ticks;
+  while (ticks == t)
+    barrier ();
+  start = rdtsc ();
+  t = ticks;
+  while (ticks < t + TSC_CALIBRATE_TICKS)
+    barrier ();
+  end = rdtsc ();
+
+  hz = (end - start) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+  if (hz < TSC_MIN_HZ)
+    return;
+  printf ("TSC runs at %'"PRIu64" Hz.\n", hz);
+
+  /* Continue from the tick-based clock. */
+  old_level = intr_disable ();
+  ns_mult = ((uint64_t) NS_PER_SEC << NS_SHIFT) / hz;
+  nanos_base = timer_ticks () * NS_PER_TICK;
+  tsc_base = rdtsc ();
+  tsc_hz = hz;
+  intr_set_level (old_level);
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -222,7 +627,20 @@ real_time_sleep (int64_t num, int32_t denom)
   int64_t ticks = num * TIMER_FREQ / denom;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
+  if (tsc_hz != 0)
+    {
+      /* Sleep through the whole ticks, giving the CPU to other
+         threads, then spin on the clock for the sub-tick rest.
+         Blocking for less than a tick would oversleep by up to a
+         tick, which short device waits cannot afford. */
+      int64_t end = timer_nanos () + num * (NS_PER_SEC / denom);
+
+      if (ticks > 0)
+        timer_sleep (ticks);
+      while (timer_nanos () < end)
+        asm volatile ("pause");
+    }
+  else if (ticks > 0)
     {
       /* We're waiting for at least one full timer tick.  Use
          timer_sleep() because it will yield the CPU to other
@@ -244,5 +662,15 @@ real_time_delay (int64_t num, int32_t denom)
   /* Scale the numerator and denominator down by 1000 to avoid
      the possibility of overflow. */
   ASSERT (denom % 1000 == 0);
-  busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
+  if (tsc_hz != 0)
+    {
+      /* Spin on the clock, which unlike busy_wait() keeps time
+         however long interrupts take. */
+      int64_t end = timer_nanos () + num * (NS_PER_SEC / denom);
+
+      while (timer_nanos () < end)
+        asm volatile ("pause");
+    }
+  else
+    busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
 }
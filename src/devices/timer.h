@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -13,6 +15,10 @@ void timer_calibrate (void);
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
 
+/* High-resolution clock. */
+#define NS_PER_SEC 1000000000
+int64_t timer_nanos (void);
+
 /* Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
@@ -26,4 +32,31 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
+/* Tickless operation. */
+extern bool timer_tickless;
+void timer_tick_stop (void);
+void timer_tick_start (void);
+
+/* Kernel timers.
+
+   A timer event calls FUNC(AUX) from the timer interrupt handler
+   once timer_ticks() reaches its deadline.  FUNC runs with
+   interrupts off and must not sleep, but it may add the event
+   again to make it periodic.  The struct timer_event must stay
+   valid until it fires or is canceled. */
+typedef void timer_event_func (void *aux);
+
+struct timer_event
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t deadline;           /* Tick at which to fire. */
+    timer_event_func *func;     /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Added and not yet fired? */
+  };
+
+void timer_event_init (struct timer_event *, timer_event_func *, void *aux);
+void timer_event_add (struct timer_event *, int64_t deadline);
+bool timer_event_cancel (struct timer_event *);
+
 #endif /* devices/timer.h */
@@ -1,8 +1,27 @@
 #include "filesys/cache.h"
+#include <string.h>
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 
+/* Timer ticks between write-backs of dirty cache blocks. */
+#define FLUSH_TICKS (5 * TIMER_FREQ)
+
+/* Periodic write-back: flush_event fires every FLUSH_TICKS and
+   submits flush_work to the kernel work queue. */
+static struct timer_event flush_event;
+static struct work flush_work;
+
+static void flush_event_func (void *aux);
+static void flush_work_func (void *aux);
+
+/* Bumped, with cache_lock held, whenever a cache block is
+   written to disk, so that a read-ahead that read a sector
+   without the lock can tell its data may be stale. */
+static unsigned write_cnt;
+
+static struct cache_entry *cache_slot (void);
 
 /* return the cache block with block sector is SECTOR 
    return null if not found in cache
@@ -23,15 +42,27 @@ struct cache_entry *cache_block(block_sector_t sector)
 
   return (void*)(0);
 }
-/* Initialize the cache , create a always-runnnin process
-   to write the dirty cache back every 5 TIME FREQUENCY
+/* Initialize the cache, and start writing the dirty cache back
+   every FLUSH_TICKS from the kernel work queue.
 */
 void cache_init(void)
 {
   lock_init(&cache_lock);
+  lock_register(&cache_lock, "cache");
   cache_size = 0; //frest init filesys cache size as zero.
   list_init(&cache_list);
-  thread_create("filesys_cache_writeback", 0, cache_back_loop, NULL);
+  work_init(&flush_work, flush_work_func, NULL);
+  timer_event_init(&flush_event, flush_event_func, NULL);
+  timer_event_add(&flush_event, timer_ticks() + FLUSH_TICKS);
+}
+
+/* Stops the periodic write-back, waits for deferred file system
+   work to finish, then writes back and frees the whole cache. */
+void cache_done(void)
+{
+  timer_event_cancel(&flush_event);
+  workqueue_drain();
+  cache_write_disk(true);
 }
 
 
@@ -68,7 +99,24 @@ struct cache_entry *cache_get_block(block_sector_t sector, int dirty){
 struct cache_entry *cache_replace(block_sector_t sector,
                                               int dirty)
 {
-    struct cache_entry *cache;
+  struct cache_entry *cache = cache_slot();
+
+  if (cache == NULL)
+      return NULL;
+  cache->count++;
+  cache->sector = sector;
+  block_read(fs_device,cache->sector, &cache->block);
+  cache->dirty = dirty;
+  cache->reference_bit= 1;
+  return cache;
+}
+
+/* Returns a cache block to hold a new sector, writing back the
+   one it held if needed, or a null pointer if there is none.
+   The caller fills it in.  cache_lock must be held. */
+static struct cache_entry *cache_slot(void)
+{
+    struct cache_entry *cache = NULL;
     struct cache_entry *replace;
     struct list_elem *e;
 
@@ -91,6 +139,7 @@ struct cache_entry *cache_replace(block_sector_t sector,
                 case 2:
                   if (replace->dirty) {
                           block_write(fs_device, replace->sector, &replace->block);
+                          write_cnt++;
                       }
                       cache = replace;
                 case 3:
@@ -99,12 +148,6 @@ struct cache_entry *cache_replace(block_sector_t sector,
           break;
           }
     }
-        
-  cache->count++;
-  cache->sector = sector;
-  block_read(fs_device,cache->sector, &cache->block);
-  cache->dirty = dirty;
-  cache->reference_bit= 1;
   return cache;
 }
 
@@ -117,15 +160,18 @@ void cache_write_disk(int is_removed){
   struct list_elem *next, *e = list_begin(&cache_list);
   while (e != list_end(&cache_list)) {
       struct cache_entry *cache = list_entry(e, struct cache_entry, elem);
+      next = list_next(e);
       int cur_cache_state = cache->dirty * 2 + is_removed;
       switch (cur_cache_state) {
       case 2:
           block_write(fs_device, cache->sector, &cache->block);
           cache->dirty = 0;
+          write_cnt++;
           break;
       case 3:
           block_write(fs_device, cache->sector, &cache->block);
           cache->dirty = 0;
+          write_cnt++;
           list_remove(&cache->elem);
           free(cache);
           break;
@@ -133,19 +179,59 @@ void cache_write_disk(int is_removed){
           list_remove(&cache->elem);
           free(cache);
       }
-      e = list_next(&cache_list);
+      e = next;
   }
   lock_release(&cache_lock);
 }
 
-/* execute write back dirty cache every 5 time in the sequnce. */
-void cache_back_loop(void *aux UNUSED)
+/* Timer callback for the periodic write-back.  Runs in the timer
+   interrupt, so it only queues the work.  If the last write-back
+   is still queued, this one is dropped. */
+static void flush_event_func(void *aux UNUSED)
 {
-  for (int i=INT32_MIN; i <INT32_MAX;i++)
-  {
-      timer_sleep((i > 0) ? i : -i);
-      cache_write_disk(0);
+  work_submit(&flush_work, PRI_MIN);
+  timer_event_add(&flush_event, flush_event.deadline + FLUSH_TICKS);
+}
+
+/* Writes back the dirty cache blocks. */
+static void flush_work_func(void *aux UNUSED)
+{
+  cache_write_disk(0);
+}
+
+/* Reads SECTOR into the cache, if it is not there already, for
+   a sequential reader that will want it soon.  Called from a
+   worker thread.  Unlike cache_get_block(), does not hold
+   cache_lock during the disk read, so foreground reads of cached
+   sectors go on meanwhile.  This is only a hint: if the cache has
+   no free block, or a block was written back while reading, so
+   that the data read may be stale, nothing is cached. */
+void cache_readahead(block_sector_t sector)
+{
+  uint8_t data[BLOCK_SECTOR_SIZE];
+  struct cache_entry *cache;
+  unsigned writes;
+
+  lock_acquire(&cache_lock);
+  cache = cache_block(sector);
+  writes = write_cnt;
+  lock_release(&cache_lock);
+  if (cache != NULL)
+      return;
+
+  block_read(fs_device, sector, data);
+
+  lock_acquire(&cache_lock);
+  if (cache_block(sector) == NULL && write_cnt == writes) {
+      cache = cache_slot();
+      if (cache != NULL) {
+          cache->sector = sector;
+          memcpy(cache->block, data, BLOCK_SECTOR_SIZE);
+          cache->dirty = 0;
+          cache->reference_bit = 1;
+      }
   }
+  lock_release(&cache_lock);
 }
 
 /* Cache flash to disk, return the number of flash block*/
@@ -160,6 +246,7 @@ int cache_examine(void) {
             case 2:
                 block_write(fs_device,cache->sector, &cache->block);
                 cache->dirty = 0;
+                write_cnt++;
                 try++;
 
         }
@@ -27,6 +27,7 @@ struct cache_entry {
 };
 
 void cache_init (void);
+void cache_done (void);
 struct cache_entry *cache_block (block_sector_t sector);
 struct cache_entry *cache_get_block(block_sector_t sector, int dirty);
 struct cache_entry* cache_replace (block_sector_t sector, int dirty);
@@ -34,7 +35,7 @@ struct cache_entry* cache_replace (block_sector_t sector, int dirty);
 
 
 void cache_write_disk (int is_removed);                   /* Write back to the disk. */
-void cache_back_loop (void *aux);                         /* Back loop to write the whole things back */
+void cache_readahead (block_sector_t sector);             /* Read SECTOR ahead of a reader. */
 int cache_examine (void);                                 /* CACHE_FLUSH implementation */
 
 #endif /* filesys/cache.h */
\ No newline at end of file
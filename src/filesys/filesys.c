@@ -43,7 +43,7 @@ void
 filesys_done (void) 
 {
   // write back all cache t
-  cache_write_disk(true);
+  cache_done();
   free_map_close ();
 }
 
@@ -96,10 +96,10 @@ parse_file_path (const char *name,
   int ok;
   
   /* Find starting directory. */
-  if (name[0] == '/' || thread_current ()->curr_dir == NULL)
+  if (name[0] == '/' || thread_process ()->curr_dir == NULL)
     dir = dir_open_root ();
   else
-    dir = dir_reopen (thread_current ()->curr_dir);
+    dir = dir_reopen (thread_process ()->curr_dir);
   if (dir == NULL || !dir_exist(dir)){  // check if this directory has been removed
     /* Return failure. */
     dir_close (dir);
@@ -320,8 +320,8 @@ filesys_chdir (const char *name)
   struct dir *dir = dir_open (name_to_inode (name));
   if (dir != NULL) 
     {
-      dir_close (thread_current ()->curr_dir);
-      thread_current ()->curr_dir = dir;
+      dir_close (thread_process ()->curr_dir);
+      thread_process ()->curr_dir = dir;
       return true;
     }
   else
@@ -5,13 +5,19 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 #include "cache.h"
 
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+static void inode_dealloc_work (void *inode_);
+static void inode_readahead_work (void *sector_);
+static void inode_readahead (struct inode *, off_t start, off_t end);
+
 
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -142,9 +148,12 @@ inode_open (block_sector_t sector)
   
   /* Synchronize with other thread. */
   lock_init(&inode->extend_lock);
+  lock_register(&inode->extend_lock, "inode extend");
   block_read(fs_device, inode->sector, &inode->data);
   inode->length = inode->data.length;
   inode->length_for_read = inode->data.length;
+  inode->ra_next = 0;
+  work_init (&inode->ra_work, inode_readahead_work, NULL);
 
   return inode;
 }
@@ -180,18 +189,37 @@ inode_close (struct inode *inode)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+
+      /* A read-ahead that has not started would use INODE. */
+      work_cancel (&inode->ra_work);
  
-      /* Deallocate blocks if removed. */
+      /* Deallocate blocks if removed.  That reads the indirect
+         blocks, so leave it to a worker thread, which then frees
+         INODE. */
       if (inode->removed) 
         {
-          free_map_release (inode->sector, 1);
-          inode_deallocate (inode);
+          work_init (&inode->dealloc_work, inode_dealloc_work, inode);
+          work_submit (&inode->dealloc_work, PRI_MIN);
         }
-
-      free (inode); 
+      else
+        free (inode); 
     }
 }
 
+/* Work function that frees the blocks of removed inode INODE_,
+   then INODE_ itself. */
+static void
+inode_dealloc_work (void *inode_)
+{
+  struct inode *inode = inode_;
+
+  acquire_file_lock ();
+  free_map_release (inode->sector, 1);
+  inode_deallocate (inode);
+  release_file_lock ();
+  free (inode);
+}
+
 /* Marks INODE to be deleted when it is closed by the last caller who
    has it open. */
 void
@@ -210,6 +238,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
   off_t read_length = inode->length_for_read;
+  off_t start = offset;
 
   /* do not allow to read beyound the read length
      because someone may be write beyound current length */
@@ -245,9 +274,50 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       bytes_read += chunk_size;
     }
 
+  if (bytes_read > 0)
+    inode_readahead (inode, start, offset);
   return bytes_read;
 }
 
+/* Called after a read of INODE from START up to END.  If the read
+   picked up where the previous one left off, queues a read of the
+   sector after END into the cache.  Each inode has at most one
+   read-ahead queued: while it waits, later reads do not add more. */
+static void
+inode_readahead (struct inode *inode, off_t start, off_t end)
+{
+  bool sequential = start == inode->ra_next;
+  off_t next_ofs = ROUND_UP (end, BLOCK_SECTOR_SIZE);
+  enum intr_level old_level;
+  block_sector_t next;
+
+  inode->ra_next = end;
+  if (!sequential || next_ofs >= inode->length_for_read)
+    return;
+  next = byte_to_sector (inode, next_ofs);
+  if (next == (block_sector_t) -1)
+    return;
+
+  /* The sector travels in the work item's AUX, so the work does
+     not touch INODE, which may be closed while it runs. */
+  old_level = intr_disable ();
+  if (!work_pending (&inode->ra_work))
+    {
+      work_init (&inode->ra_work, inode_readahead_work,
+                 (void *) (uintptr_t) next);
+      work_submit (&inode->ra_work, PRI_DEFAULT);
+    }
+  intr_set_level (old_level);
+}
+
+/* Work function that reads sector SECTOR_ into the cache ahead of
+   a sequential reader. */
+static void
+inode_readahead_work (void *sector_)
+{
+  cache_readahead ((block_sector_t) (uintptr_t) sector_);
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
    less than SIZE if end of file is reached or an error occurs.
@@ -6,6 +6,7 @@
 #include "devices/block.h"
 #include <list.h>
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 struct bitmap;
 
 /* On-disk inode.
@@ -36,6 +37,9 @@ struct inode
     struct inode_disk data;             /* Inode content. */
 
     struct lock extend_lock;
+    struct work dealloc_work;           /* Deferred deallocation. */
+    struct work ra_work;                /* Queued read-ahead. */
+    off_t ra_next;                      /* Where a sequential read goes on. */
     
     off_t length;                       /* File size in bytes. */
     off_t length_for_read;              /* Calculate the File size in bytes. */
@@ -0,0 +1,14 @@
+#ifndef __LIB_CLOCK_H
+#define __LIB_CLOCK_H
+
+/* Clocks for the clock_gettime system call. */
+#define CLOCK_MONOTONIC 1       /* Time since boot, never set back. */
+
+/* A time, as returned by the clock_gettime system call. */
+struct timespec
+  {
+    long long tv_sec;           /* Seconds. */
+    long tv_nsec;               /* Nanoseconds, 0 to 999,999,999. */
+  };
+
+#endif /* lib/clock.h */
@@ -0,0 +1,14 @@
+#ifndef __LIB_MADVISE_H
+#define __LIB_MADVISE_H
+
+/* Access pattern hints for the madvise system call. */
+enum
+  {
+    MADV_NORMAL,                /* No particular pattern. */
+    MADV_SEQUENTIAL,            /* Read ahead aggressively. */
+    MADV_RANDOM,                /* Map only the faulting page. */
+    MADV_WILLNEED,              /* Bring the pages in now. */
+    MADV_DONTNEED               /* Drop the pages now. */
+  };
+
+#endif /* lib/madvise.h */
@@ -29,7 +29,20 @@ enum
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
     SYS_INUMBER,                /* Returns the inode number for a fd. */
-    SYS_CACHE_FLUSH             /* Returns if the cache needs flushing. */
+    SYS_CACHE_FLUSH,            /* Returns if the cache needs flushing. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate the calling process. */
+    SYS_VMSTAT,                 /* Get virtual memory statistics. */
+    SYS_MADVISE,                /* Give a hint about memory use. */
+    SYS_MLOCK,                  /* Lock pages in memory. */
+    SYS_MUNLOCK,                /* Unlock pages locked by mlock. */
+    SYS_FUTEX_WAIT,             /* Sleep while a word has a value. */
+    SYS_FUTEX_WAKE,             /* Wake threads sleeping on a word. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_EXIT,            /* End the calling thread. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to end. */
+    SYS_CLOCK_GETTIME           /* Read a high-resolution clock. */
   };
 
 #endif /* lib/syscall-nr.h */
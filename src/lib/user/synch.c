@@ -0,0 +1,97 @@
+#include <synch.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* The mutex is Drepper's "mutex 2" from "Futexes Are Tricky":
+   a waiter marks the mutex 2 before sleeping, so that unlock
+   calls futex_wake() only when someone may be asleep. */
+
+/* Initializes M as unlocked. */
+void
+mutex_init (struct mutex *m)
+{
+  m->state = 0;
+}
+
+/* Acquires M, sleeping until it is available if necessary. */
+void
+mutex_lock (struct mutex *m)
+{
+  int c = __sync_val_compare_and_swap (&m->state, 0, 1);
+
+  if (c == 0)
+    return;
+  if (c != 2)
+    c = __sync_lock_test_and_set (&m->state, 2);
+  while (c != 0)
+    {
+      futex_wait (&m->state, 2);
+      c = __sync_lock_test_and_set (&m->state, 2);
+    }
+}
+
+/* Acquires M and returns true if it is unlocked, otherwise
+   returns false without waiting. */
+bool
+mutex_trylock (struct mutex *m)
+{
+  return __sync_bool_compare_and_swap (&m->state, 0, 1);
+}
+
+/* Releases M, which the caller must hold. */
+void
+mutex_unlock (struct mutex *m)
+{
+  if (__sync_fetch_and_sub (&m->state, 1) != 1)
+    {
+      m->state = 0;
+      futex_wake (&m->state, 1);
+    }
+}
+
+/* Initializes CV. */
+void
+condvar_init (struct condvar *cv)
+{
+  cv->seq = 0;
+  cv->waiters = 0;
+}
+
+/* Atomically releases M and waits for CV to be signaled, then
+   reacquires M.  M must be held.  As with any condition variable,
+   the caller must recheck its condition afterward. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m)
+{
+  int seq = cv->seq;
+
+  __sync_fetch_and_add (&cv->waiters, 1);
+  mutex_unlock (m);
+  futex_wait (&cv->seq, seq);
+  __sync_fetch_and_sub (&cv->waiters, 1);
+
+  /* Others may have been woken along with us, so take M as if
+     it had waiters. */
+  while (__sync_lock_test_and_set (&m->state, 2) != 0)
+    futex_wait (&m->state, 2);
+}
+
+/* Wakes one thread waiting on CV, if any.  A waiter counts
+   itself before releasing its mutex, so if the condition was
+   changed with the mutex held, no waiter can be missed. */
+void
+condvar_signal (struct condvar *cv)
+{
+  __sync_fetch_and_add (&cv->seq, 1);
+  if (cv->waiters > 0)
+    futex_wake (&cv->seq, 1);
+}
+
+/* Wakes all threads waiting on CV. */
+void
+condvar_broadcast (struct condvar *cv)
+{
+  __sync_fetch_and_add (&cv->seq, 1);
+  if (cv->waiters > 0)
+    futex_wake (&cv->seq, INT_MAX);
+}
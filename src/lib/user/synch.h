@@ -0,0 +1,42 @@
+#ifndef __LIB_USER_SYNCH_H
+#define __LIB_USER_SYNCH_H
+
+#include <stdbool.h>
+
+/* User-space mutexes and condition variables built on futexes.
+   Locking an unlocked mutex, unlocking one nobody waits for, and
+   signaling a condition nobody waits on never enter the kernel.
+
+   They work between threads that share the memory holding them.
+   A variable in a page shared only copy-on-write after fork() is
+   no longer shared once either process writes it. */
+
+/* Mutex. */
+struct mutex
+  {
+    int state;                  /* 0: unlocked, 1: locked,
+                                   2: locked, maybe with waiters. */
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* Condition variable. */
+struct condvar
+  {
+    int seq;                    /* Bumped by every signal. */
+    int waiters;                /* Threads in condvar_wait(). */
+  };
+
+#define CONDVAR_INITIALIZER { 0, 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/synch.h */
@@ -187,4 +187,79 @@ int
 cache_flush (void)
 {
   return syscall0 (SYS_CACHE_FLUSH);
-}
\ No newline at end of file
+}
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+bool
+vmstat (struct vmstat *stat)
+{
+  return syscall1 (SYS_VMSTAT, stat);
+}
+
+int
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+mlock (const void *addr, unsigned length)
+{
+  return syscall2 (SYS_MLOCK, addr, length);
+}
+
+int
+munlock (const void *addr, unsigned length)
+{
+  return syscall2 (SYS_MUNLOCK, addr, length);
+}
+
+int
+futex_wait (int *addr, int expected)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, expected);
+}
+
+int
+futex_wake (int *addr, int count)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, count);
+}
+
+/* First code run by a thread started by thread_create(). */
+static void
+thread_start (void (*func) (void *), void *aux)
+{
+  func (aux);
+  thread_exit (0);
+}
+
+tid_t
+thread_create (void (*func) (void *), void *aux)
+{
+  return syscall3 (SYS_THREAD_CREATE, thread_start, func, aux);
+}
+
+void
+thread_exit (int status)
+{
+  syscall1 (SYS_THREAD_EXIT, status);
+  NOT_REACHED ();
+}
+
+int
+thread_join (tid_t tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+int
+clock_gettime (int clock, struct timespec *ts)
+{
+  return syscall2 (SYS_CLOCK_GETTIME, clock, ts);
+}
@@ -2,7 +2,10 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <clock.h>
 #include <debug.h>
+#include <madvise.h>
+#include <vmstat.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +15,10 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -46,4 +53,17 @@ bool isdir (int fd);
 int inumber (int fd);
 int cache_flush (void);
 
+/* Extensions. */
+pid_t fork (void);
+bool vmstat (struct vmstat *);
+int madvise (void *addr, unsigned length, int advice);
+int mlock (const void *addr, unsigned length);
+int munlock (const void *addr, unsigned length);
+int futex_wait (int *addr, int expected);
+int futex_wake (int *addr, int count);
+tid_t thread_create (void (*func) (void *), void *aux);
+void thread_exit (int status) NO_RETURN;
+int thread_join (tid_t);
+int clock_gettime (int clock, struct timespec *);
+
 #endif /* lib/user/syscall.h */
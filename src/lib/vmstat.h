@@ -0,0 +1,17 @@
+#ifndef __LIB_VMSTAT_H
+#define __LIB_VMSTAT_H
+
+/* Virtual memory statistics of a process, as returned by the
+   vmstat system call. */
+struct vmstat
+  {
+    int minor_faults;           /* Faults resolved without I/O. */
+    int major_faults;           /* Faults that read swap or a file. */
+    int evictions;              /* Pages evicted from memory. */
+    int swap_ins;               /* Pages read back from swap. */
+    int rss;                    /* Pages resident in memory. */
+    int peak_rss;               /* Largest RSS so far. */
+    int locked;                 /* Pages locked by mlock(). */
+  };
+
+#endif /* lib/vmstat.h */
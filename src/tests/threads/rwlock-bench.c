@@ -0,0 +1,220 @@
+/* Compares a reader-writer lock against a plain lock on a
+   workload of 95% reads and 5% writes, run by several threads of
+   equal priority.  Every critical section sleeps for a tick, in
+   place of a blocking disk access, so that other threads want
+   the lock while it is held.  Readers check that they never see
+   a half-finished write.
+
+   Before the workload, checks the try-variants and that a writer
+   holding two rwlocks keeps the donation through one when it
+   releases the other. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8            /* Number of threads. */
+#define OP_CNT 20               /* Operations per thread. */
+#define WRITE_PERIOD 20         /* One operation in this many writes. */
+#define DATA_CNT 64             /* Size of the shared data. */
+
+struct bench
+  {
+    bool use_rwlock;            /* Use rwlock or lock? */
+    struct rwlock rwlock;
+    struct lock lock;
+    struct semaphore done;      /* Upped by each thread at exit. */
+    int data[DATA_CNT];         /* Shared data, all elements equal. */
+    int writes;                 /* Completed writes. */
+  };
+
+static thread_func bench_thread;
+static int64_t run_bench (struct bench *, bool use_rwlock);
+static void check_try_acquire (void);
+static void check_donation (void);
+
+void
+test_rwlock_bench (void) 
+{
+  static struct bench bench;
+  int64_t rwlock_ticks, lock_ticks;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  check_try_acquire ();
+  check_donation ();
+  msg ("%d threads doing %d operations each, 1 in %d a write",
+       THREAD_CNT, OP_CNT, WRITE_PERIOD);
+  rwlock_ticks = run_bench (&bench, true);
+  lock_ticks = run_bench (&bench, false);
+  msg ("rwlock: %"PRId64" ticks", rwlock_ticks);
+  msg ("lock: %"PRId64" ticks", lock_ticks);
+  pass ();
+}
+
+/* Checks that rwlock_try_acquire_read() and
+   rwlock_try_acquire_write() succeed exactly when the blocking
+   versions would not sleep. */
+static void
+check_try_acquire (void) 
+{
+  struct rwlock rw;
+
+  rwlock_init (&rw);
+  if (!rwlock_try_acquire_write (&rw))
+    fail ("try_acquire_write failed on a free rwlock");
+  if (rwlock_try_acquire_read (&rw))
+    fail ("try_acquire_read succeeded against a writer");
+  rwlock_release_write (&rw);
+
+  if (!rwlock_try_acquire_read (&rw) || !rwlock_try_acquire_read (&rw))
+    fail ("try_acquire_read failed with only readers");
+  if (rwlock_try_acquire_write (&rw))
+    fail ("try_acquire_write succeeded against readers");
+  rwlock_release_read (&rw);
+  if (rwlock_try_acquire_write (&rw))
+    fail ("try_acquire_write succeeded against a reader");
+  rwlock_release_read (&rw);
+  if (!rwlock_try_acquire_write (&rw))
+    fail ("try_acquire_write failed after readers left");
+  rwlock_release_write (&rw);
+  msg ("try-acquire ok");
+}
+
+static thread_func donor_read_thread;
+static thread_func donor_write_thread;
+
+/* Holds two rwlocks for writing while a higher-priority thread
+   waits on each, then releases them one at a time, checking the
+   priority left after each release. */
+static void
+check_donation (void) 
+{
+  static struct rwlock a, b;
+
+  rwlock_init (&a);
+  rwlock_init (&b);
+  rwlock_acquire_write (&a);
+  rwlock_acquire_write (&b);
+
+  /* Each donor runs at once, since it outranks us, and blocks. */
+  thread_create ("donor b", PRI_DEFAULT + 1, donor_write_thread, &b);
+  thread_create ("donor a", PRI_DEFAULT + 2, donor_read_thread, &a);
+  if (thread_get_priority () != PRI_DEFAULT + 2)
+    fail ("priority %d with both donors waiting, expected %d",
+          thread_get_priority (), PRI_DEFAULT + 2);
+
+  rwlock_release_write (&a);
+  if (thread_get_priority () != PRI_DEFAULT + 1)
+    fail ("priority %d after releasing a, expected %d",
+          thread_get_priority (), PRI_DEFAULT + 1);
+
+  rwlock_release_write (&b);
+  if (thread_get_priority () != PRI_DEFAULT)
+    fail ("priority %d after releasing b, expected %d",
+          thread_get_priority (), PRI_DEFAULT);
+  msg ("donation ok");
+}
+
+static void
+donor_read_thread (void *rw) 
+{
+  rwlock_acquire_read (rw);
+  rwlock_release_read (rw);
+}
+
+static void
+donor_write_thread (void *rw) 
+{
+  rwlock_acquire_write (rw);
+  rwlock_release_write (rw);
+}
+
+/* Runs the workload on BENCH with a reader-writer lock if
+   USE_RWLOCK is true, or a lock otherwise, and returns the
+   number of timer ticks it took. */
+static int64_t
+run_bench (struct bench *b, bool use_rwlock) 
+{
+  int64_t start;
+  int i;
+
+  b->use_rwlock = use_rwlock;
+  rwlock_init (&b->rwlock);
+  lock_init (&b->lock);
+  sema_init (&b->done, 0);
+  for (i = 0; i < DATA_CNT; i++)
+    b->data[i] = 0;
+  b->writes = 0;
+
+  start = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "bench %d", i);
+      thread_create (name, PRI_DEFAULT, bench_thread, b);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&b->done);
+
+  if (b->writes != THREAD_CNT * OP_CNT / WRITE_PERIOD)
+    fail ("%d writes instead of %d", b->writes,
+          THREAD_CNT * OP_CNT / WRITE_PERIOD);
+  for (i = 0; i < DATA_CNT; i++)
+    if (b->data[i] != b->writes)
+      fail ("data[%d] is %d after %d writes", i, b->data[i], b->writes);
+  return timer_elapsed (start);
+}
+
+static void
+bench_thread (void *b_) 
+{
+  struct bench *b = b_;
+  static int next_id;
+  int id = next_id++;
+  int op, i;
+
+  for (op = 0; op < OP_CNT; op++)
+    if ((op + id) % WRITE_PERIOD == 0)
+      {
+        if (b->use_rwlock)
+          rwlock_acquire_write (&b->rwlock);
+        else
+          lock_acquire (&b->lock);
+        for (i = 0; i < DATA_CNT; i++)
+          {
+            b->data[i]++;
+            if (i == DATA_CNT / 2)
+              timer_sleep (1);
+          }
+        b->writes++;
+        if (b->use_rwlock)
+          rwlock_release_write (&b->rwlock);
+        else
+          lock_release (&b->lock);
+      }
+    else
+      {
+        int value;
+
+        if (b->use_rwlock)
+          rwlock_acquire_read (&b->rwlock);
+        else
+          lock_acquire (&b->lock);
+        value = b->data[0];
+        timer_sleep (1);
+        for (i = 1; i < DATA_CNT; i++)
+          if (b->data[i] != value)
+            fail ("read data[%d] = %d, expected %d", i, b->data[i], value);
+        if (b->use_rwlock)
+          rwlock_release_read (&b->rwlock);
+        else
+          lock_release (&b->lock);
+      }
+  sema_up (&b->done);
+}
@@ -0,0 +1,23 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+fail "try-acquire check did not pass"
+  unless grep ($_ eq '(rwlock-bench) try-acquire ok', @output);
+fail "donation check did not pass"
+  unless grep ($_ eq '(rwlock-bench) donation ok', @output);
+fail "missing rwlock timing in output"
+  unless grep (/^\(rwlock-bench\) rwlock: \d+ ticks$/, @output);
+fail "missing lock timing in output"
+  unless grep (/^\(rwlock-bench\) lock: \d+ ticks$/, @output);
+fail "missing PASS in output"
+  unless grep ($_ eq '(rwlock-bench) PASS', @output);
+
+pass;
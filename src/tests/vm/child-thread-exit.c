@@ -0,0 +1,23 @@
+/* Child process of thread-exit.
+   Starts a thread that calls exit(57), then spins forever.  Only
+   the end of the whole process stops the spinning. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-thread-exit";
+
+static void
+exit_thread (void *aux UNUSED)
+{
+  exit (57);
+}
+
+int
+main (void)
+{
+  if (thread_create (exit_thread, NULL) == TID_ERROR)
+    fail ("thread_create failed");
+  for (;;)
+    continue;
+}
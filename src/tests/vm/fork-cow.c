@@ -0,0 +1,43 @@
+/* Forks and checks that the child sees the parent's data, bss
+   and stack, and that the child's writes to them stay private. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096)
+
+static char data[SIZE] = "parent data";
+static char bss[SIZE];
+
+void
+test_main (void)
+{
+  int local = 42;
+  pid_t pid;
+  size_t i;
+
+  memset (bss, 'p', sizeof bss);
+  pid = fork ();
+  if (pid == 0)
+    {
+      CHECK (!strcmp (data, "parent data") && local == 42
+             && bss[0] == 'p' && bss[sizeof bss - 1] == 'p',
+             "child sees parent data");
+      strlcpy (data, "child data", sizeof data);
+      memset (bss, 'c', sizeof bss);
+      local = 0;
+      exit (81);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork");
+
+  CHECK (wait (pid) == 81, "wait for child (should return 81)");
+  if (strcmp (data, "parent data") || local != 42)
+    fail ("child's writes reached parent data");
+  for (i = 0; i < sizeof bss; i++)
+    if (bss[i] != 'p')
+      fail ("child's writes reached parent bss at offset %zu", i);
+  msg ("parent data unchanged");
+}
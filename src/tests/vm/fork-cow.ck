@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-cow) begin
+(fork-cow) child sees parent data
+(fork-cow) wait for child (should return 81)
+(fork-cow) parent data unchanged
+(fork-cow) end
+EOF
+pass;
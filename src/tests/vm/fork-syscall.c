@@ -0,0 +1,52 @@
+/* Forks and has the child's system calls write into buffers it
+   still shares copy-on-write with the parent: a stack buffer for
+   vmstat() and a bss buffer for clock_gettime().  The kernel must
+   give the child its own copies before writing, leaving the
+   parent's buffers alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILL 0xcc
+
+static struct timespec ts;
+
+/* Returns true if all SIZE bytes at BUF equal FILL. */
+static bool
+unchanged (const void *buf, size_t size)
+{
+  const unsigned char *p = buf;
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (p[i] != FILL)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  struct vmstat s;
+  pid_t pid;
+
+  memset (&s, FILL, sizeof s);
+  memset (&ts, FILL, sizeof ts);
+  pid = fork ();
+  if (pid == 0)
+    {
+      CHECK (vmstat (&s), "child vmstat into shared stack");
+      CHECK (clock_gettime (CLOCK_MONOTONIC, &ts) == 0,
+             "child clock_gettime into shared bss");
+      exit (82);
+    }
+  if (pid == PID_ERROR)
+    fail ("fork");
+
+  CHECK (wait (pid) == 82, "wait for child (should return 82)");
+  if (!unchanged (&s, sizeof s) || !unchanged (&ts, sizeof ts))
+    fail ("child's system calls wrote parent memory");
+  msg ("parent buffers unchanged");
+}
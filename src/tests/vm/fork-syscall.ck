@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-syscall) begin
+(fork-syscall) child vmstat into shared stack
+(fork-syscall) child clock_gettime into shared bss
+(fork-syscall) wait for child (should return 82)
+(fork-syscall) parent buffers unchanged
+(fork-syscall) end
+EOF
+pass;
@@ -0,0 +1,29 @@
+/* Checks the futex system calls and the user-space mutex built on
+   them without contention.  futex_wait() must return at once when
+   the word does not hold the expected value, futex_wake() must
+   wake nobody when nobody waits, and a mutex must lock, refuse a
+   second lock, and unlock. */
+
+#include <syscall.h>
+#include <synch.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int word = 1;
+static struct mutex mutex = MUTEX_INITIALIZER;
+
+void
+test_main (void)
+{
+  CHECK (futex_wait (&word, 0) == -1,
+         "futex_wait on a changed word returns -1");
+  CHECK (futex_wake (&word, 1) == 0,
+         "futex_wake with no waiters returns 0");
+
+  mutex_lock (&mutex);
+  CHECK (!mutex_trylock (&mutex), "trylock a locked mutex fails");
+  mutex_unlock (&mutex);
+  CHECK (mutex_trylock (&mutex), "trylock an unlocked mutex succeeds");
+  mutex_unlock (&mutex);
+  CHECK (mutex.state == 0, "mutex left unlocked");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(futex-basic) begin
+(futex-basic) futex_wait on a changed word returns -1
+(futex-basic) futex_wake with no waiters returns 0
+(futex-basic) trylock a locked mutex fails
+(futex-basic) trylock an unlocked mutex succeeds
+(futex-basic) mutex left unlocked
+(futex-basic) end
+EOF
+pass;
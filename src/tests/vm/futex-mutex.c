@@ -0,0 +1,52 @@
+/* Has several threads increment a shared counter under a
+   user-space mutex, each increment reading the counter, spinning
+   for a while, and then writing it back, so that timer
+   interrupts often preempt a thread holding the mutex and the
+   others must sleep on its futex.  Checks that no increment was
+   lost. */
+
+#include <syscall.h>
+#include <synch.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4            /* Number of threads. */
+#define INC_CNT 1000            /* Increments per thread. */
+#define SPIN_CNT 1000           /* Loop iterations inside the mutex. */
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+static int counter;
+
+static void
+increment (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < INC_CNT; i++)
+    {
+      volatile int spin;
+      int value;
+
+      mutex_lock (&mutex);
+      value = counter;
+      for (spin = 0; spin < SPIN_CNT; spin++)
+        continue;
+      counter = value + 1;
+      mutex_unlock (&mutex);
+    }
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK ((tids[i] = thread_create (increment, NULL)) != TID_ERROR,
+           "create thread %d", i);
+  for (i = 0; i < THREAD_CNT; i++)
+    CHECK (thread_join (tids[i]) == 0, "join thread %d", i);
+  CHECK (counter == THREAD_CNT * INC_CNT,
+         "counter is %d (should be %d)", counter, THREAD_CNT * INC_CNT);
+}
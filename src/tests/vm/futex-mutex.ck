@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(futex-mutex) begin
+(futex-mutex) create thread 0
+(futex-mutex) create thread 1
+(futex-mutex) create thread 2
+(futex-mutex) create thread 3
+(futex-mutex) join thread 0
+(futex-mutex) join thread 1
+(futex-mutex) join thread 2
+(futex-mutex) join thread 3
+(futex-mutex) counter is 4000 (should be 4000)
+(futex-mutex) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Runs child-thread-exit, in which a second thread calls exit()
+   while the main thread spins, and checks that the whole child
+   process ends with that thread's status. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  CHECK ((child = exec ("child-thread-exit")) != -1,
+         "exec \"child-thread-exit\"");
+  CHECK (wait (child) == 57, "wait for child (should return 57)");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(thread-exit) begin
+(thread-exit) exec "child-thread-exit"
+(thread-exit) wait for child (should return 57)
+(thread-exit) end
+EOF
+pass;
@@ -0,0 +1,39 @@
+/* Starts threads in the process's address space and joins them.
+   thread_join() must return the status passed to thread_exit(),
+   or 0 for a thread whose function returned, and -1 for a thread
+   already joined. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static int shared;
+
+static void
+exit_thread (void *aux)
+{
+  shared = (int) aux;
+  thread_exit ((int) aux + 1);
+}
+
+static void
+return_thread (void *aux UNUSED)
+{
+}
+
+void
+test_main (void)
+{
+  tid_t tid;
+
+  CHECK ((tid = thread_create (exit_thread, (void *) 41)) != TID_ERROR,
+         "create thread");
+  CHECK (thread_join (tid) == 42, "join thread (should return 42)");
+  CHECK (shared == 41, "thread's write is visible");
+  CHECK (thread_join (tid) == -1, "join thread again (should return -1)");
+
+  CHECK ((tid = thread_create (return_thread, NULL)) != TID_ERROR,
+         "create returning thread");
+  CHECK (thread_join (tid) == 0,
+         "join returning thread (should return 0)");
+}
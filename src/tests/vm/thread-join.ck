@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(thread-join) begin
+(thread-join) create thread
+(thread-join) join thread (should return 42)
+(thread-join) thread's write is visible
+(thread-join) join thread again (should return -1)
+(thread-join) create returning thread
+(thread-join) join returning thread (should return 0)
+(thread-join) end
+EOF
+pass;
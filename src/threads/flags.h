@@ -5,4 +5,10 @@
 #define FLAG_MBS  0x00000002    /* Must be set. */
 #define FLAG_IF   0x00000200    /* Interrupt Flag. */
 
+/* CR4 Register. */
+#define CR4_PSE   0x00000010    /* Page Size Extensions (4 MB pages). */
+
+/* CPUID leaf 1, EDX feature bits. */
+#define CPUID_PSE 0x00000008    /* 4 MB pages supported. */
+
 #endif /* threads/flags.h */
@@ -15,13 +15,16 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -39,6 +42,8 @@
 #endif
 #ifdef VM
 #include "vm/frame.h"
+#include "vm/futex.h"
+#include "vm/page.h"
 #include "vm/swap.h"
 #endif
 /* Page directory with kernel mappings only. */
@@ -62,6 +67,7 @@ static size_t user_page_limit = SIZE_MAX;
 
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -120,6 +126,7 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_init ();
   serial_init_queue ();
   timer_calibrate ();
 
@@ -131,8 +138,10 @@ main (void)
 #endif
 
 #ifdef VM
-  frame_init();
   swap_init();
+  frame_init();
+  page_init();
+  futex_init();
 #endif
 
   printf ("Boot complete.\n");
@@ -161,13 +170,29 @@ bss_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports it, each 4 MB of physical memory that lies
+   entirely in RAM is mapped with one large page, which takes a
+   single TLB entry instead of 1024.  The 4 MB holding the kernel
+   text and any partial 4 MB at the end of RAM keep 4 kB pages, so
+   that the text stays read-only. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  bool pse = cpu_has_pse ();
+
+  if (pse)
+    {
+      /* Enable 4 MB pages.  See [IA32-v3a] 3.6.1 "Paging
+         Options". */
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -179,6 +204,15 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0
+          && init_ram_pages - page >= PTSPAN / PGSIZE
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -196,6 +230,17 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages (PSE), as reported
+   by CPUID.  See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pse (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+
+  asm ("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx) : "a" (1));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -264,9 +309,23 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-lockstat"))
+        lockstat_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-fa"))
+        page_fault_around_pages = atoi (value);
+      else if (!strcmp (name, "-zs"))
+        swap_pool_pages = atoi (value);
+      else if (!strcmp (name, "-vmstat"))
+        page_print_vmstat = true;
+      else if (!strcmp (name, "-ml"))
+        page_mlock_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -387,8 +446,16 @@ usage (void)
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the timer tick while idle or alone.\n"
+          "  -lockstat          Print lock contention statistics at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -fa=COUNT          Map up to COUNT resident pages around faults.\n"
+          "  -zs=PAGES          Use PAGES pages for compressed swap (0=none).\n"
+          "  -vmstat            Print VM statistics of each process at exit.\n"
+          "  -ml=PAGES          Let each process mlock() up to PAGES pages.\n"
 #endif
           );
   shutdown_power_off ();
@@ -9,6 +9,9 @@
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -258,6 +261,23 @@ pic_init (void)
   outb (PIC1_DATA, 0x00);
 }
 
+/* Returns true if external interrupt VEC_NO has been raised but
+   not yet delivered, according to the PIC's interrupt request
+   register.  Useful with interrupts off. */
+bool
+intr_ext_pending (uint8_t vec_no)
+{
+  ASSERT (vec_no >= 0x20 && vec_no < 0x30);
+
+  if (vec_no < 0x28)
+    {
+      outb (PIC0_CTRL, 0x0a);   /* OCW3: read IRR on next read. */
+      return (inb (PIC0_CTRL) & (1 << (vec_no - 0x20))) != 0;
+    }
+  outb (PIC1_CTRL, 0x0a);       /* OCW3: read IRR on next read. */
+  return (inb (PIC1_CTRL) & (1 << (vec_no - 0x28))) != 0;
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -361,7 +381,7 @@ intr_handler (struct intr_frame *frame)
       yield_on_return = false;
     } 
     #ifdef VM
-    else
+    else if (frame->cs == SEL_UCSEG)
       thread_current()->stack_pointer = frame ->esp;
     #endif
 
@@ -390,6 +410,16 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return) 
         thread_yield (); 
     }
+
+#ifdef USERPROG
+  /* Another thread of the process has ended it.  Exit instead of
+     returning to user mode. */
+  if (frame->cs == SEL_UCSEG && thread_current ()->process->exiting)
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+#endif
 }
 
 /* Handles an unexpected interrupt with interrupt frame F.  An
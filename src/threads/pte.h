@@ -66,6 +66,7 @@ static inline uintptr_t pd_no (const void *va) {
 #define PTE_U 0x4               /* 1=user/kernel, 0=kernel only. */
 #define PTE_A 0x20              /* 1=accessed, 0=not acccessed. */
 #define PTE_D 0x40              /* 1=dirty, 0=not dirty (PTEs only). */
+#define PTE_PS 0x80             /* 1=4 MB page, 0=page table (PDEs only). */
 
 /* Returns a PDE that points to page table PT. */
 static inline uint32_t pde_create (uint32_t *pt) {
@@ -73,6 +74,16 @@ static inline uint32_t pde_create (uint32_t *pt) {
   return vtop (pt) | PTE_U | PTE_P | PTE_W;
 }
 
+/* Returns a PDE that maps the 4 MB of memory starting at PAGE,
+   which must be 4 MB aligned, as a single large page.  The CPU
+   must support PSE, and it must be enabled in CR4.  The memory
+   is readable, and writable as well if WRITABLE is true, by ring
+   0 code only. */
+static inline uint32_t pde_create_large (void *page, bool writable) {
+  ASSERT (((uintptr_t) page & (PTSPAN - 1)) == 0);
+  return vtop (page) | PTE_PS | PTE_P | (writable ? PTE_W : 0);
+}
+
 /* Returns a pointer to the page table that page directory entry
    PDE, which must "present", points to. */
 static inline uint32_t *pde_get_pt (uint32_t pde) {
@@ -31,6 +31,7 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -177,10 +178,145 @@ lock_init (struct lock *lock)
   ASSERT (lock != NULL);
 
   lock->holder = NULL;
+  lock->stat = NULL;
 
   sema_init (&lock->semaphore, 1);
 }
 
+/* Contention statistics for all the locks registered under one
+   name. */
+struct lockstat
+  {
+    const char *name;           /* Name given to lock_register(). */
+    long long acquisitions;     /* Times acquired. */
+    long long contended;        /* Times a thread had to wait. */
+    long long wait_ns;          /* Total nanoseconds spent waiting. */
+    long long max_hold;         /* Longest time held, in ns. */
+  };
+
+/* If true, registered locks keep contention statistics.  Set by
+   the "-lockstat" kernel command-line option. */
+bool lockstat_enabled;
+
+/* Registered lock names.  Statistics for a name that does not fit
+   are not kept. */
+#define LOCKSTAT_MAX 32
+static struct lockstat lockstats[LOCKSTAT_MAX];
+static int lockstat_cnt;
+
+/* Number of locks printed by lock_print_stats(). */
+#define LOCKSTAT_TOP 8
+
+/* Registers LOCK, which must not be held, for contention
+   statistics under NAME.  Locks registered under the same name,
+   such as all the locks of one kind of object, share a single set
+   of statistics.  NAME must remain valid forever. */
+void
+lock_register (struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+  int i;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+
+  old_level = intr_disable ();
+  for (i = 0; i < lockstat_cnt; i++)
+    if (!strcmp (lockstats[i].name, name))
+      break;
+  if (i == lockstat_cnt && lockstat_cnt < LOCKSTAT_MAX)
+    lockstats[lockstat_cnt++].name = name;
+  lock->stat = i < lockstat_cnt ? &lockstats[i] : NULL;
+  intr_set_level (old_level);
+}
+
+/* Acquires registered LOCK like sema_down(), recording whether
+   the current thread had to wait and for how long. */
+static void
+lockstat_acquire (struct lock *lock)
+{
+  struct lockstat *s = lock->stat;
+  enum intr_level old_level;
+  int64_t wait = -1;
+
+  if (!sema_try_down (&lock->semaphore))
+    {
+      int64_t start = timer_nanos ();
+      sema_down (&lock->semaphore);
+      wait = timer_nanos () - start;
+    }
+
+  /* Other locks may share S, so update it atomically. */
+  old_level = intr_disable ();
+  s->acquisitions++;
+  if (wait >= 0)
+    {
+      s->contended++;
+      s->wait_ns += wait;
+    }
+  intr_set_level (old_level);
+  lock->acquired_at = timer_nanos ();
+}
+
+/* Records the release of registered LOCK. */
+static void
+lockstat_release (struct lock *lock)
+{
+  struct lockstat *s = lock->stat;
+  int64_t held = timer_nanos () - lock->acquired_at;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (held > s->max_hold)
+    s->max_hold = held;
+  intr_set_level (old_level);
+}
+
+/* Prints statistics for the most contended registered locks,
+   those that waited longest first. */
+void
+lock_print_stats (void)
+{
+  struct lockstat *top[LOCKSTAT_TOP];
+  int top_cnt = 0;
+  int i;
+
+  if (!lockstat_enabled)
+    return;
+
+  /* Insertion sort by wait time, then contended acquisitions. */
+  for (i = 0; i < lockstat_cnt; i++)
+    {
+      struct lockstat *s = &lockstats[i];
+      int j;
+
+      if (s->acquisitions == 0)
+        continue;
+      for (j = top_cnt; j > 0; j--)
+        {
+          struct lockstat *t = top[j - 1];
+          if (t->wait_ns > s->wait_ns
+              || (t->wait_ns == s->wait_ns
+                  && t->contended >= s->contended))
+            break;
+          if (j < LOCKSTAT_TOP)
+            top[j] = t;
+        }
+      if (j < LOCKSTAT_TOP)
+        {
+          top[j] = s;
+          if (top_cnt < LOCKSTAT_TOP)
+            top_cnt++;
+        }
+    }
+
+  for (i = 0; i < top_cnt; i++)
+    printf ("Lock %s: %lld acquisitions, %lld contended, "
+            "%lld us waiting, %lld us max hold\n",
+            top[i]->name, top[i]->acquisitions, top[i]->contended,
+            top[i]->wait_ns / 1000, top[i]->max_hold / 1000);
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -222,7 +358,9 @@ lock_acquire (struct lock *lock)
               cur_t->priority = lock->priority;
       }
       intr_set_level(old_level);
-  } else
+  } else if (lockstat_enabled && lock->stat != NULL)
+      lockstat_acquire(lock);
+  else
       sema_down(&lock->semaphore);
   lock->holder = thread_current();
 }
@@ -264,8 +402,15 @@ lock_try_acquire (struct lock *lock)
         intr_set_level(old_level);
   } else
       success = sema_try_down(&lock->semaphore);
-  if (success)
+  if (success) {
       lock->holder = thread_current();
+      if (lockstat_enabled && lock->stat != NULL) {
+          enum intr_level old_level = intr_disable();
+          lock->stat->acquisitions++;
+          intr_set_level(old_level);
+          lock->acquired_at = timer_nanos();
+      }
+  }
   return success;
 }
 
@@ -280,6 +425,8 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  if (lockstat_enabled && lock->stat != NULL)
+    lockstat_release (lock);
   lock->holder = NULL;
   sema_up (&lock->semaphore);
 }
@@ -295,6 +442,236 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/* Initializes RW, which is initially free.
+
+   A reader-writer lock lets any number of readers hold it at
+   once, or a single writer.  It suits data that is read much
+   more often than it is written.  Like a lock, it is not
+   recursive, and must be released by the thread that acquired
+   it.  A writer waits for all readers to release the lock, and
+   readers that arrive while a writer is waiting wait behind it,
+   so that writers do not starve.  A waiter with a higher
+   priority than the writer holding the lock donates its priority
+   to the writer until the writer releases the lock.  Readers
+   receive no donations, since the lock does not track them. */
+void
+rwlock_init (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+}
+
+/* Raises the priority of RW's writer to that of the current
+   thread, which is about to wait for RW, if it is higher.
+   Interrupts must be off. */
+static void
+rwlock_donate (struct rwlock *rw)
+{
+  int priority = thread_get_priority ();
+
+  if (!thread_mlfqs && rw->writer != NULL
+      && rw->writer->priority < priority)
+    thread_set_effective_priority (rw->writer, priority);
+}
+
+/* Makes T the writer holding RW.  Interrupts must be off. */
+static void
+rwlock_set_writer (struct rwlock *rw, struct thread *t)
+{
+  rw->writer = t;
+  list_push_back (&t->rwlocks, &rw->elem);
+}
+
+/* Makes the highest-priority waiting writer the holder of RW,
+   which must be free, or else all of the waiting readers.
+   Interrupts must be off. */
+static void
+rwlock_wake (struct rwlock *rw)
+{
+  ASSERT (rw->writer == NULL && rw->readers == 0);
+
+  if (!list_empty (&rw->write_waiters))
+    {
+      struct list_elem *e = list_max (&rw->write_waiters,
+                                      thread_less_priority, NULL);
+      struct thread *t = list_entry (e, struct thread, elem);
+
+      list_remove (e);
+      rwlock_set_writer (rw, t);
+
+      /* The remaining waiters donate to the new writer. */
+      thread_refresh_priority (t);
+      thread_unblock (t);
+    }
+  else
+    while (!list_empty (&rw->read_waiters))
+      {
+        rw->readers++;
+        thread_unblock (list_entry (list_pop_front (&rw->read_waiters),
+                                    struct thread, elem));
+      }
+}
+
+/* Acquires RW for reading, sleeping until no writer holds it or
+   waits for it.  This function may sleep, so it must not be
+   called within an interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != thread_current ());
+
+  old_level = intr_disable ();
+  if (rw->writer != NULL || !list_empty (&rw->write_waiters))
+    {
+      /* The thread that wakes us counts us as a reader. */
+      rwlock_donate (rw);
+      list_push_back (&rw->read_waiters, &thread_current ()->elem);
+      thread_block ();
+    }
+  else
+    rw->readers++;
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false on failure. */
+bool
+rwlock_try_acquire_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && list_empty (&rw->write_waiters);
+  if (success)
+    rw->readers++;
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rwlock_release_read (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rw->readers > 0 && rw->writer == NULL);
+  if (--rw->readers == 0)
+    rwlock_wake (rw);
+  intr_set_level (old_level);
+  thread_yield_to_higher ();
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  This function may sleep, so it must not be called within
+   an interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != thread_current ());
+
+  old_level = intr_disable ();
+  if (rw->writer != NULL || rw->readers > 0)
+    {
+      /* The thread that wakes us makes us the writer. */
+      rwlock_donate (rw);
+      list_push_back (&rw->write_waiters, &thread_current ()->elem);
+      thread_block ();
+    }
+  else
+    rwlock_set_writer (rw, thread_current ());
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false on failure. */
+bool
+rwlock_try_acquire_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  old_level = intr_disable ();
+  success = rw->writer == NULL && rw->readers == 0;
+  if (success)
+    rwlock_set_writer (rw, thread_current ());
+  intr_set_level (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread holds for writing, and
+   gives up any priority donated to it through RW.  Donations
+   through other rwlocks the thread still holds for writing are
+   kept. */
+void
+rwlock_release_write (struct rwlock *rw)
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_held_for_write (rw));
+
+  old_level = intr_disable ();
+  rw->writer = NULL;
+  list_remove (&rw->elem);
+  thread_refresh_priority (thread_current ());
+  rwlock_wake (rw);
+  intr_set_level (old_level);
+  thread_yield_to_higher ();
+}
+
+/* Returns true if the current thread holds RW for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Returns the highest priority of a thread waiting for RW, or
+   PRI_UNVALID if none is.  Interrupts must be off. */
+int
+rwlock_waiter_priority (const struct rwlock *rw)
+{
+  const struct list *waiters[2] = {&rw->read_waiters, &rw->write_waiters};
+  int priority = PRI_UNVALID;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < 2; i++)
+    if (!list_empty (waiters[i]))
+      {
+        struct list_elem *e = list_max ((struct list *) waiters[i],
+                                        thread_less_priority, NULL);
+        struct thread *t = list_entry (e, struct thread, elem);
+
+        if (t->priority > priority)
+          priority = t->priority;
+      }
+  return priority;
+}
+
 /* One semaphore in a list. */
 struct semaphore_elem 
   {
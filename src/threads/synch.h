@@ -3,6 +3,7 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /* A counting semaphore. */
 struct semaphore 
@@ -25,14 +26,44 @@ struct lock
     int priority;                                     //get the current priority
     struct list_elem elem;                            //list element in struct thread
     struct semaphore semaphore;                       /* Binary semaphore controlling access. */
+    struct lockstat *stat;                            /* Contention statistics, or null. */
+    int64_t acquired_at;                              /* timer_nanos() at acquisition, for statistics. */
   };
 
 void lock_init (struct lock *);
+void lock_register (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 
+/* Lock contention statistics, enabled by the "-lockstat" kernel
+   command-line option. */
+extern bool lockstat_enabled;
+void lock_print_stats (void);
+
+/* Reader-writer lock.  Any number of readers or a single writer
+   may hold it.  Writers are preferred: once a writer is waiting,
+   new readers wait too. */
+struct rwlock
+  {
+    int readers;                /* Number of readers holding it. */
+    struct thread *writer;      /* Writer holding it, or null. */
+    struct list_elem elem;      /* Element in writer's `rwlocks' list. */
+    struct list read_waiters;   /* Readers waiting for it. */
+    struct list write_waiters;  /* Writers waiting for it. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
+int rwlock_waiter_priority (const struct rwlock *);
+
 /* Condition variable. */
 struct condition 
   {
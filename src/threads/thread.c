@@ -7,15 +7,18 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "filesys/file.h"
 #include "userprog/syscall.h"
 #ifdef VM
 #include <hash.h>
 #include "vm/frame.h"
+#include "vm/page.h"
 #endif
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -27,19 +30,41 @@
 /* set avg parameter for loading. */      
 static int load_avg;
 
+/* MLFQS decays recent_cpu once a second.  Only the running and
+   ready threads are decayed on time; a blocked thread catches up
+   when it is unblocked, applying the decay factors of the seconds
+   it missed, of which the last DECAY_HISTORY are kept. */
+#define DECAY_HISTORY 64
+static unsigned decay_epoch;                /* Seconds decayed so far. */
+static int decay_factor[DECAY_HISTORY];     /* Factor of each second. */
+static long long mlfqs_ticks;               /* Ticks seen by thread_tick(). */
+
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, in one FIFO queue per
+   priority.  Bit N of ready_map is set when ready_queues[N] is
+   not empty, so the highest ready priority is a find-last-set
+   away. */
+#define READY_MAP_BITS 32
+#define READY_MAP_WORDS ((PRI_MAX + READY_MAP_BITS) / READY_MAP_BITS)
+static struct list ready_queues[PRI_MAX + 1];
+static uint32_t ready_map[READY_MAP_WORDS];
+static int ready_cnt;                   /* Threads in ready_queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
+/* Every thread, hashed by tid into TID_BUCKETS lists, from when
+   it gets its tid until it exits.  Protected, like all_list, by
+   disabling interrupts. */
+#define TID_BUCKETS 256
+static struct list tid_buckets[TID_BUCKETS];
+
 /* Idle thread. */
 static struct thread *idle_thread;
 
@@ -85,6 +110,16 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void tid_insert (struct thread *);
+static void wsem_exit (void);
+static tid_t create_thread (const char *name, int priority,
+                            thread_func *, void *aux, bool waitable);
+static void wsem_release (struct wsem *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_decay (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -102,13 +137,19 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
   lock_init (&file_lock);
-  list_init (&ready_list);
+  lock_register (&tid_lock, "tid");
+  lock_register (&file_lock, "file system");
+  for (i = 0; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
-  list_init (&sleep_list);
+  for (i = 0; i < TID_BUCKETS; i++)
+    list_init (&tid_buckets[i]);
 
   load_avg = 0;             //init the avg to 0
 
@@ -116,6 +157,7 @@ thread_init (void)
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   thread_set_tid(initial_thread,0);  
+  tid_insert (initial_thread);
   initial_thread->status = THREAD_RUNNING;
 }
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -152,11 +194,65 @@ thread_tick (void)
   else
     kernel_ticks++;
 
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+
   /* Enforce preemption. */
   if (++thread_ticks >= TIME_SLICE)
     intr_yield_on_return ();
 }
 
+/* Does the MLFQS bookkeeping for a timer tick while T is
+   running.  Only T's priority can change between seconds, since
+   only T's recent_cpu grows. */
+static void
+mlfqs_tick (struct thread *t)
+{
+  mlfqs_ticks++;
+  thread_increase_recent_cpu ();
+
+  if (mlfqs_ticks % TIMER_FREQ == 0)
+    mlfqs_decay ();
+  else if (mlfqs_ticks % 4 == 0)
+    thread_recalculate_priority (t, NULL);
+
+  if (ready_max_priority () > t->priority)
+    intr_yield_on_return ();
+}
+
+/* Updates the load average and decays recent_cpu of the running
+   and ready threads, once a second.  Ready threads move to their
+   new priority's queue. */
+static void
+mlfqs_decay (void)
+{
+  int pri;
+
+  thread_recalculate_load_avg ();
+  decay_epoch++;
+  decay_factor[decay_epoch % DECAY_HISTORY]
+    = ((int64_t) (2 * load_avg)) * fp_one / (2 * load_avg + fp_one);
+
+  thread_recalculate_recent_cpu (thread_current (), NULL);
+  thread_recalculate_priority (thread_current (), NULL);
+  for (pri = PRI_MIN; pri <= PRI_MAX; pri++)
+    {
+      struct list_elem *e, *next;
+
+      /* A thread requeued onto a queue not yet visited is visited
+         again, which is harmless. */
+      for (e = list_begin (&ready_queues[pri]);
+           e != list_end (&ready_queues[pri]); e = next)
+        {
+          struct thread *t = list_entry (e, struct thread, elem);
+
+          next = list_next (e);
+          thread_recalculate_recent_cpu (t, NULL);
+          thread_recalculate_priority (t, NULL);
+        }
+    }
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
@@ -177,12 +273,29 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the running thread yields to it. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
+{
+  return create_thread (name, priority, function, aux, false);
+}
+
+/* Like thread_create(), but the new thread is a child process of
+   the running thread, which may wait for it with thread_wait(). */
+tid_t
+thread_create_child (const char *name, int priority,
+                     thread_func *function, void *aux) 
+{
+  return create_thread (name, priority, function, aux, true);
+}
+
+/* Creates a thread for thread_create() or, if WAITABLE is true,
+   thread_create_child(). */
+static tid_t
+create_thread (const char *name, int priority,
+               thread_func *function, void *aux, bool waitable) 
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
@@ -201,12 +314,36 @@ thread_create (const char *name, int priority,
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
-  // allocate space for child thread struct
-  struct wsem *wsem = malloc(sizeof(struct wsem));
-  wsem->tid = tid;
-  // add the child thread struct to the childs of the current thread 
-  list_push_back (&thread_current()->child_list, &(wsem->wsem_elem));
-  
+  if (thread_mlfqs)
+    {
+      old_level = intr_disable ();
+      thread_recalculate_priority (t, NULL);
+      intr_set_level (old_level);
+    }
+
+  /* Record for thread_wait(), shared with the creator.  Threads
+     nobody waits for get none, so that their creator does not
+     collect records until it exits. */
+  if (waitable)
+    {
+      t->wsem = malloc (sizeof *t->wsem);
+      if (t->wsem == NULL)
+        {
+          old_level = intr_disable ();
+          list_remove (&t->allelem);
+          intr_set_level (old_level);
+          palloc_free_page (t);
+          return TID_ERROR;
+        }
+      t->wsem->tid = tid;
+      t->wsem->ret_status = -1;
+      lock_init (&t->wsem->lock);
+      t->wsem->ref_cnt = 2;
+      sema_init (&t->wsem->dead, 0);
+      list_push_back (&thread_current ()->child_list,
+                      &t->wsem->wsem_elem);
+    }
+
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
      member cannot be observed. */
@@ -227,10 +364,12 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
+  tid_insert (t);
   intr_set_level (old_level);
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_yield_to_higher ();
 
   return tid;
 }
@@ -268,8 +407,14 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (thread_mlfqs && t != idle_thread)
+    {
+      thread_recalculate_recent_cpu (t, NULL);
+      thread_recalculate_priority (t, NULL);
+    }
   t->status = THREAD_READY;
+  ready_push (t);
+  timer_tick_start ();
   intr_set_level (old_level);
 }
 
@@ -280,17 +425,82 @@ thread_name (void)
   return thread_current ()->name;
 }
 
-void
-thread_wait(struct thread *t,int child_tid)
+/* Waits for thread CHILD_TID, created by the running thread
+   with thread_create_child(), to exit and returns its exit status.  Returns -1 at once if
+   CHILD_TID is not such a thread or has already been waited
+   for. */
+int
+thread_wait (tid_t child_tid)
 {
-    for (struct list_elem *e = list_begin (&all_list); e != list_end (&all_list); e = list_next (e))
-  {
-    t = list_entry (e, struct thread, allelem);
-    if(t->tid==child_tid){
-        sema_down(&t->cwem);
-        break;
+  struct thread *cur = thread_current ();
+  struct wsem *wsem = NULL;
+  struct thread *t;
+  enum intr_level old_level;
+  int status;
+
+  /* A running child is found through the tid table.  It clears
+     its `wsem' as it exits, which also ends any wait for it. */
+  old_level = intr_disable ();
+  t = find_thread_id (child_tid);
+  if (t != NULL && t->parent == cur)
+    wsem = t->wsem;
+  intr_set_level (old_level);
+
+  /* Otherwise look among the records of exited children. */
+  if (wsem == NULL)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list);
+           e = list_next (e))
+        if (list_entry (e, struct wsem, wsem_elem)->tid == child_tid)
+          {
+            wsem = list_entry (e, struct wsem, wsem_elem);
+            break;
+          }
+      if (wsem == NULL)
+        return -1;
     }
-  }
+
+  list_remove (&wsem->wsem_elem);
+  sema_down (&wsem->dead);
+  status = wsem->ret_status;
+  wsem_release (wsem);
+  return status;
+}
+
+/* Reports the running thread's exit status to a thread_wait() by
+   its creator, and gives up the records of its own children. */
+static void
+wsem_exit (void)
+{
+  struct thread *cur = thread_current ();
+  struct wsem *wsem = cur->wsem;
+
+  if (wsem != NULL)
+    {
+      wsem->ret_status = cur->ret_status;
+      cur->wsem = NULL;
+      sema_up (&wsem->dead);
+      wsem_release (wsem);
+    }
+  while (!list_empty (&cur->child_list))
+    wsem_release (list_entry (list_pop_front (&cur->child_list),
+                              struct wsem, wsem_elem));
+}
+
+/* Drops a reference to WSEM, freeing it when neither the parent
+   nor the child needs it any more. */
+static void
+wsem_release (struct wsem *wsem)
+{
+  int ref_cnt;
+
+  lock_acquire (&wsem->lock);
+  ref_cnt = --wsem->ref_cnt;
+  lock_release (&wsem->lock);
+  if (ref_cnt == 0)
+    free (wsem);
 }
 
 /* Returns the running thread.
@@ -312,6 +522,16 @@ thread_current (void)
   return t;
 }
 
+/* Returns the main thread of the running thread's process, which
+   owns its address space and open files.  That is the running
+   thread itself unless it was started by the thread_create()
+   system call. */
+struct thread *
+thread_process (void)
+{
+  return thread_current ()->process;
+}
+
 /* Returns the running thread's tid. */
 tid_t
 thread_tid (void) 
@@ -330,38 +550,36 @@ thread_exit (void)
   process_exit ();
 #endif
 
-  intr_disable ();
-
-  if( thread_current()->parent->load_status){
-    printf("%s: exit(%d)\n",thread_name(),thread_current()->ret_status);
-  }
-
-  struct list_elem *e;
-  struct list *l = &thread_current()->parent->child_list;
-  struct wsem *wsem;
+  /* Threads started by thread_create() leave the process's
+     status and files to its main thread. */
+  if (thread_current ()->process == thread_current ())
+    {
+      if( thread_current()->parent->load_status){
+        printf("%s: exit(%d)\n",thread_name(),thread_current()->ret_status);
+#ifdef VM
+        page_print_stats();
+#endif
+      }
 
-  for (e = list_begin(l); e != list_end(l); e = list_next(e)) {
-    wsem = list_entry(e, struct wsem, wsem_elem);
-    if(wsem->tid == thread_current()->tid) {
-      wsem->ret_status = thread_current()->ret_status;
-      break;
+      file_close(thread_current()->elffile);
+      struct list *files = &thread_current()->fds;
+      while(!list_empty(files))
+      {
+        struct file_node *f = list_entry (list_pop_front(files), struct file_node, file_elem);
+        file_close(f->file);
+        free(f);
+      }
     }
-  }
 
-  sema_up(&thread_current()->cwem);
-  file_close(thread_current()->elffile);
-  struct list *files = &thread_current()->fds;
-  while(!list_empty(files))
-  {
-    struct file_node *f = list_entry (list_pop_front(files), struct file_node, file_elem);
-    file_close(f->file);
-    free(f);
-  }
+  wsem_exit ();
+
+  intr_disable ();
 
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   list_remove (&thread_current()->allelem);
+  list_remove (&thread_current()->tidelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -378,9 +596,9 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
   cur->status = THREAD_READY;
+  if (cur != idle_thread) 
+    ready_push (cur);
   schedule ();
   intr_set_level (old_level);
 }
@@ -402,11 +620,92 @@ thread_foreach (thread_action_func *func, void *aux)
     }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's priority to NEW_PRIORITY, yielding
+   if a ready thread now has a higher priority.  Priority donated
+   to the thread still applies on top of NEW_PRIORITY. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  cur->base_priority = new_priority;
+  if (thread_mlfqs)
+    thread_set_effective_priority (cur, new_priority);
+  else
+    thread_refresh_priority (cur);
+  intr_set_level (old_level);
+
+  thread_yield_to_higher ();
+}
+
+/* Yields the CPU if a ready thread has a higher priority than
+   the running thread.  In an interrupt handler, yields on return
+   from the interrupt instead. */
+void
+thread_yield_to_higher (void)
+{
+  if (ready_max_priority () <= thread_get_priority ())
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_yield ();
+}
+
+/* Sets T's effective priority to PRIORITY.  A ready thread moves
+   to the tail of its new priority's queue, so this is constant
+   time.  Interrupts must be off. */
+void
+thread_set_effective_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  if (t->priority == priority)
+    return;
+  if (t->status == THREAD_READY && t != idle_thread)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+}
+
+/* Recomputes T's effective priority as its base priority, raised
+   to that of the highest-priority thread waiting for an rwlock T
+   holds for writing.  Under the MLFQS, priorities are computed
+   rather than donated, so this does nothing.  Interrupts must be
+   off. */
+void
+thread_refresh_priority (struct thread *t)
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_mlfqs)
+    return;
+  for (e = list_begin (&t->rwlocks); e != list_end (&t->rwlocks);
+       e = list_next (e))
+    {
+      int donated = rwlock_waiter_priority (list_entry (e, struct rwlock,
+                                                        elem));
+      if (donated > priority)
+        priority = donated;
+    }
+  thread_set_effective_priority (t, priority);
+}
+
+/* Returns the number of threads ready to run, not counting the
+   running thread. */
+int
+thread_ready_count (void)
+{
+  return ready_cnt;
 }
 
 /* Returns the current thread's priority. */
@@ -421,8 +720,10 @@ void
 thread_set_nice (int nice UNUSED) 
 {
   struct thread *t = thread_current();
+  enum intr_level old_level = intr_disable ();
   t->nice = nice;
   thread_recalculate_priority(t,NULL);
+  intr_set_level (old_level);
   thread_yield();
 }
 
@@ -544,22 +845,30 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
+  t->base_priority = priority;
+  list_init (&t->rwlocks);
 
   t->nice = 0;            //set the origin to 0
   t->recent_cpu = 0;      //set the origin to 0
+  t->recent_cpu_epoch = decay_epoch;
 
   t->magic = THREAD_MAGIC;
   // initiable thread relative variables
   list_init(&t->child_list);
   list_init(&t->fds);
+  list_init(&t->mappings);
   sema_init(&t->esem,0);
-  sema_init(&t->cwem, 0);
 
   t->load_status = true;
   t->ret_status = -1;
   t->elffile = NULL;
   t->next_handle = 2;
 
+  t->process = t;
+  lock_init (&t->vm_lock);
+  list_init (&t->uthreads);
+  sema_init (&t->uthread_sema, 0);
+
   if(t == initial_thread) t->parent = NULL;
   else t->parent = thread_current();
 
@@ -589,13 +898,54 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-    if (list_empty(&ready_list)) {
-        return idle_thread;
-    } else {
-        struct list_elem *front = list_front(&ready_list);
-        list_remove(front);
-        return list_entry(front, struct thread, elem);
-    }
+  int pri = ready_max_priority ();
+  struct thread *t;
+
+  if (pri == PRI_UNVALID)
+    return idle_thread;
+  t = list_entry (list_front (&ready_queues[pri]), struct thread, elem);
+  ready_remove (t);
+  return t;
+}
+
+/* Appends T, which must be ready, to the queue for its
+   priority.  Interrupts must be off. */
+static void
+ready_push (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_map[t->priority / READY_MAP_BITS] |= 1u << t->priority % READY_MAP_BITS;
+  ready_cnt++;
+}
+
+/* Removes ready thread T from its priority's queue.  Interrupts
+   must be off. */
+static void
+ready_remove (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_map[t->priority / READY_MAP_BITS]
+      &= ~(1u << t->priority % READY_MAP_BITS);
+  ready_cnt--;
+}
+
+/* Returns the highest priority with a ready thread, or
+   PRI_UNVALID if no thread is ready. */
+static int
+ready_max_priority (void)
+{
+  int i;
+
+  for (i = READY_MAP_WORDS - 1; i >= 0; i--)
+    if (ready_map[i] != 0)
+      return i * READY_MAP_BITS + 31 - __builtin_clz (ready_map[i]);
+  return PRI_UNVALID;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -624,8 +974,11 @@ thread_schedule_tail (struct thread *prev)
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
 
-  /* Start new time slice. */
+  /* Start new time slice.  With nothing else to run, the
+     periodic tick can stop. */
   thread_ticks = 0;
+  if (ready_cnt == 0)
+    timer_tick_stop ();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -667,18 +1020,41 @@ schedule (void)
   thread_schedule_tail (prev);
 }
 
-/* Returns a tid to use for a new thread. */
+/* Returns the tid table bucket for TID. */
+static struct list *
+tid_bucket (tid_t tid)
+{
+  return &tid_buckets[(unsigned) tid % TID_BUCKETS];
+}
+
+/* Adds T, which must have its tid, to the tid table.  Interrupts
+   must be off. */
+static void
+tid_insert (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  list_push_back (tid_bucket (t->tid), &t->tidelem);
+}
+
+/* Returns the thread whose tid is ID, or a null pointer if no
+   such thread exists.  The thread may exit as soon as interrupts
+   are enabled. */
 struct thread*
 find_thread_id(tid_t id) {
+    struct list *b = tid_bucket (id);
+    struct thread *found = NULL;
     struct list_elem *e;
-    e = list_begin(&all_list);
-    while (e != list_end(&all_list)) {
-        struct thread *t = list_entry(e, struct thread, allelem);
-        if (t->tid == id)
-            return t;
-        e = list_next(e);
+    enum intr_level old_level = intr_disable ();
+
+    for (e = list_begin (b); e != list_end (b); e = list_next (e)) {
+        struct thread *t = list_entry (e, struct thread, tidelem);
+        if (t->tid == id) {
+            found = t;
+            break;
+        }
     }
-    return NULL;
+    intr_set_level (old_level);
+    return found;
 }
 
 /* Returns a tid to use for a new thread. */
@@ -695,51 +1071,6 @@ allocate_tid (void)
   return tid;
 }
 
-/* Ticks is from lib/kernel/timer.c function 
-timer_sleep which requires the ticks(the edge
- between start and now). */
-void
-thread_sleep(int64_t ticks)
-{
-  enum intr_level old_level=intr_disable();
-
-  struct thread *t=thread_current();              //get the current thread.
-  t->sleep_ticks=ticks;                           //set the waiting ticks time for current thread.
-  list_push_back (&sleep_list, &t->slpelem);      //put the current thread into sleep_list.
-  t->status = THREAD_SLEEP;                       //update the current state to THREAD_SLEEP
-  schedule ();                                    //do the thread schedule, let out the resource for other thread
-
-  intr_set_level(old_level);
-}
-
-
-/* If needed to define a sleep version of 
-foreach, different from the general one, 
-because it's already slept, so dont need 
-the action be passed in. */
-void
-thread_foreach_sleep (void)
-{
-  enum intr_level old_level=intr_disable();
-
-  struct list_elem *e;
-  e = list_begin (&sleep_list);
-  while ( e != list_end (&sleep_list))                              //loop every element in sleep_list
-    {
-      struct thread *t = list_entry (e, struct thread, slpelem);    //get the struct of thread
-      t->sleep_ticks--;                                             //update sleep_ticks
-      if(t->sleep_ticks==0)                                         //if the waiting ticks is 0, the sleeping time is set
-      {
-        list_remove(e);                                             //remove the thread from sleep_list
-        t->status = THREAD_READY;                                   //set the thread's state into THREAD_READY
-        list_push_back (&ready_list, &t->elem);                     //put the thread into the ready list
-      }
-      e = list_next (e);
-    }
-
-  intr_set_level(old_level);
-}
-
 /* only once is fine for !less is 
 greater, UNUSED is a state to see 
 whether is used. */
@@ -768,7 +1099,7 @@ thread_priority_donate_nest(struct thread *t)
     else
       break;}                                             //if not, break.
     if(l->priority > t->priority)                         //for robustness.
-      t->priority = l->priority;
+      thread_set_effective_priority (t, l->priority);
     else
       break;
     l = t->lock_waiting;
@@ -794,9 +1125,9 @@ thread_update_priority(struct thread *t)
     }
 
   if(t->base_priority > t->locks_priority)        //update the priority.
-    t->priority = t->base_priority;               //also can be done by calling the donate_nest, but it's tedious.
+    thread_set_effective_priority (t, t->base_priority); //also can be done by calling the donate_nest, but it's tedious.
   else
-    t->priority = t->locks_priority;
+    thread_set_effective_priority (t, t->locks_priority);
   
 }
 
@@ -832,34 +1163,45 @@ thread_increase_recent_cpu(void)                                //every tick hav
 void
 thread_recalculate_load_avg(void)                               //every second have to get its variable load_avg.
 {
-  int size=list_size(&ready_list);
+  int size=ready_cnt;
   if(thread_current()!=idle_thread)
     size++;
   load_avg = load_avg*59/60 + (size)*fp_one/60;
 }
 
-/* declaration of priority lock realization. */
+/* Applies to T the recent_cpu decays of the seconds since it was
+   last decayed.  Interrupts must be off. */
 void
 thread_recalculate_recent_cpu(struct thread *t,void *aux UNUSED)          //every second have to update recent_cpu.
 {
+  unsigned missed = decay_epoch - t->recent_cpu_epoch;
+  unsigned epoch;
+
   if(t==idle_thread)
     return;
-  t->recent_cpu = (((int64_t)(2*load_avg))*fp_one/(2*load_avg+fp_one))
-                   *t->recent_cpu/fp_one+t->nice*fp_one;
+  if (missed > DECAY_HISTORY)
+    missed = DECAY_HISTORY;
+  for (epoch = decay_epoch - missed + 1; epoch != decay_epoch + 1; epoch++)
+    t->recent_cpu = (int64_t) decay_factor[epoch % DECAY_HISTORY]
+                    * t->recent_cpu / fp_one + t->nice * fp_one;
+  t->recent_cpu_epoch = decay_epoch;
 }
 
 /* declaration of priority lock realization. */
 void
 thread_recalculate_priority(struct thread *t,void *aux UNUSED)             //every four ticks have to recalculate the priority.
 {
+  int priority;
+
   if(t==idle_thread)
     return;
-  t->priority = (PRI_MAX*fp_one - (t->recent_cpu / 4) 
-                 - t->nice*2*fp_one) / fp_one;
-  if(t->priority > PRI_MAX)
-    t->priority = PRI_MAX;
-  if(t->priority < PRI_MIN)
-    t->priority = PRI_MIN;
+  priority = (PRI_MAX*fp_one - (t->recent_cpu / 4) 
+              - t->nice*2*fp_one) / fp_one;
+  if(priority > PRI_MAX)
+    priority = PRI_MAX;
+  if(priority < PRI_MIN)
+    priority = PRI_MIN;
+  thread_set_effective_priority (t, priority);
 }
 
 /* the helper function to set tid */
@@ -4,8 +4,10 @@
 #include <debug.h>
 #include <list.h>
 #include <stdint.h>
+#include <vmstat.h>
 #include "threads/synch.h"
 #include "filesys/file.h"
+#include "vm/region.h"
 /* States in a thread's life cycle. */
 enum thread_status
   {
@@ -20,7 +22,6 @@ enum thread_status
 typedef int tid_t;
 #define TID_ERROR ((tid_t) -1)          /* Error value for tid_t. */
 /*add the state of thread SLEEP=BLOCK so no need to add sleep to thread status but refer to it*/
-#define THREAD_SLEEP THREAD_BLOCKED     /* Set for new instance sleep mode. */
 /* Thread priorities. */
 #define PRI_UNVALID -1                  /* Invalid priority. */
 #define PRI_MIN 0                       /* Lowest priority. */
@@ -92,9 +93,12 @@ struct thread
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
     struct list_elem allelem;           /* List element for all threads list. */
+    struct list_elem tidelem;           /* List element in the tid table. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    int base_priority;                  /* Priority before donation. */
+    struct list rwlocks;                /* Rwlocks held for writing. */
 
     /* For Userporg, just need code file. */
     struct file *elffile;               /* Exec File */
@@ -114,31 +118,50 @@ struct thread
 
 
     /* Deprecated */
-    struct list_elem slpelem;           /* the element in sleep_list. */
-    int64_t sleep_ticks;                /* the time to wait */
     struct lock *lock_waiting;          /* locks still waiting. */
     struct list locks;                  /* locks owned by the thread. */
 
     int locks_priority;                 /* the top priority in the thread. */
-    int base_priority;                  /* the right now priority. */
     int nice;                           /* the parameter in the cpu equation. */
     int recent_cpu;                     /* the float emulated by integet. */
+    unsigned recent_cpu_epoch;          /* Second recent_cpu was last decayed. */
 
     /* For Virtual Memory */
     void *stack_pointer;                /* The variable to store the thread's esp. */
     struct hash *pages;                 /* The variable to store the page table. */
+    struct region_table regions;        /* Segments and mappings, by address. */
+    struct vmstat vmstat;               /* Fault and residency counters. */
     struct list mapped_file;            /* The memory mapped file. */
     struct list fds;                    /* List of file descriptors. */
     struct list mappings;               /* Memory-mapped files. */
     int next_handle;                    /* For next handle to deal with the problem */
     struct wsem * wsem;                 /* This process's completion status, to a smaller granularity. */
     struct semaphore esem;              /* semaphore for child thread load. */
-    struct semaphore cwem;              /* semaphore for child thread exit. */
     struct thread* parent; 
 
     /* The dir thread hold. */
     struct dir* curr_dir;
 
+    /* User threads.  The address space and files above belong to
+       the process's main thread; a thread started by the
+       thread_create() system call uses its main thread's. */
+    struct thread *process;             /* Main thread of the process,
+                                           or this thread itself. */
+    struct uthread *uthread;            /* Join record, if started by
+                                           thread_create(). */
+    struct lock vm_lock;                /* In a main thread: guards
+                                           `pages' and `regions'. */
+    struct list uthreads;               /* In a main thread: join records
+                                           of the threads it has started. */
+    int uthread_cnt;                    /* In a main thread: number of
+                                           those still running. */
+    struct semaphore uthread_sema;      /* In a main thread: upped as each
+                                           of them exits. */
+    uint32_t stack_slots;               /* In a main thread: bitmap of user
+                                           stack slots in use. */
+    bool exiting;                       /* In a main thread: true once the
+                                           process is exiting. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
@@ -149,8 +172,8 @@ struct thread
   };
   
   /* Tracks the completion of a process.
-   Reference held by both the parent, in its `children' list,
-   and by the child, in its `wait_status' pointer. */
+   Reference held by both the parent, in its `child_list',
+   and by the child, in its `wsem' pointer. */
 struct wsem {
   struct list_elem wsem_elem;
   int ret_status;
@@ -163,7 +186,20 @@ struct wsem {
 
 };
 
-struct list sleep_list;
+/* A thread started in a user process by thread_create(), which
+   another thread of the process may join.  Owned by the main
+   thread, in its `uthreads' list, until joined or the process
+   exits. */
+struct uthread
+  {
+    struct list_elem elem;      /* Element in the `uthreads' list. */
+    tid_t tid;                  /* Thread identifier. */
+    int slot;                   /* User stack slot. */
+    int status;                 /* Value passed to thread_exit(). */
+    bool exited;                /* Did it call thread_exit()? */
+    bool joined;                /* Is someone joining it? */
+    struct semaphore dead;      /* Upped when it exits. */
+  };
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
@@ -178,23 +214,30 @@ void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_child (const char *name, int priority, thread_func *,
+                          void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
+struct thread *thread_process (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_yield_to_higher (void);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+int thread_ready_count (void);
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_set_effective_priority (struct thread *, int);
+void thread_refresh_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -202,8 +245,6 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
 struct thread* find_thread_id(tid_t id);
-void thread_sleep(int64_t ticks);
-void thread_foreach_sleep (void);
 bool thread_less_priority(const struct list_elem *compare1,const struct list_elem *compare2,void *aux UNUSED);
 
 void thread_priority_donate_nest(struct thread *t);
@@ -220,6 +261,6 @@ void thread_set_tid(struct thread *t, tid_t tid);
 /* For file lock and release. */
 void acquire_file_lock(void);
 void release_file_lock(void);
-void thread_wait(struct thread *t,int child_tid);
+int thread_wait (tid_t child_tid);
 
 #endif /* threads/thread.h */
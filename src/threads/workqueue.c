@@ -0,0 +1,208 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Number of worker threads. */
+#define WORKER_CNT 2
+
+/* Queued work, highest priority first and in submission order
+   within a priority.  Interrupts must be off to touch it, since
+   work may be submitted from interrupt handlers. */
+static struct list queue;
+
+/* Worker threads running a work function.  Interrupts must be
+   off to touch it. */
+static int busy_cnt;
+
+/* Upped once for each work_submit(), so that workers sleep while
+   the queue is empty.  Canceled work leaves its count behind,
+   which only costs a worker a spurious wakeup. */
+static struct semaphore queue_sema;
+
+/* Threads in workqueue_drain() waiting for the queue to go idle,
+   which interrupts must be off to touch, and the semaphore they
+   sleep on. */
+static int drain_cnt;
+static struct semaphore drain_sema;
+
+static void worker (void *aux);
+static bool work_more_priority (const struct list_elem *,
+                                const struct list_elem *, void *aux);
+
+/* Starts the worker threads.  Work submitted earlier runs once
+   they are scheduled. */
+void
+workqueue_init (void)
+{
+  int i;
+
+  list_init (&queue);
+  sema_init (&queue_sema, 0);
+  sema_init (&drain_sema, 0);
+
+  for (i = 0; i < WORKER_CNT; i++)
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "worker %d", i);
+      thread_create (name, PRI_DEFAULT, worker, NULL);
+    }
+}
+
+/* Waits until the queue is empty and no work function is
+   running.  Returns at once if interrupts are off, as during a
+   panic, since then the workers cannot run. */
+void
+workqueue_drain (void)
+{
+  ASSERT (!intr_context ());
+
+  if (intr_get_level () == INTR_OFF)
+    return;
+  for (;;)
+    {
+      enum intr_level old_level;
+      bool idle;
+
+      old_level = intr_disable ();
+      idle = list_empty (&queue) && busy_cnt == 0;
+      if (!idle)
+        drain_cnt++;
+      intr_set_level (old_level);
+      if (idle)
+        break;
+      sema_down (&drain_sema);
+    }
+}
+
+/* Initializes W to call FUNC(AUX) when it runs. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->priority = PRI_MIN;
+  w->pending = false;
+}
+
+/* Queues W to run at PRIORITY.  Returns true if successful, false
+   if W was already queued, in which case it keeps its place.  May
+   be called from an interrupt handler. */
+bool
+work_submit (struct work *w, int priority)
+{
+  enum intr_level old_level;
+
+  ASSERT (w != NULL);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  old_level = intr_disable ();
+  if (w->pending)
+    {
+      intr_set_level (old_level);
+      return false;
+    }
+  w->priority = priority;
+  w->pending = true;
+  list_insert_ordered (&queue, &w->elem, work_more_priority, NULL);
+  intr_set_level (old_level);
+
+  sema_up (&queue_sema);
+  return true;
+}
+
+/* Returns true if W is queued and its function has not started. */
+bool
+work_pending (const struct work *w)
+{
+  enum intr_level old_level;
+  bool pending;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  pending = w->pending;
+  intr_set_level (old_level);
+  return pending;
+}
+
+/* Removes W from the queue.  Returns true if it was queued, false
+   if it was not, or its function has already started. */
+bool
+work_cancel (struct work *w)
+{
+  enum intr_level old_level;
+  bool canceled;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  canceled = w->pending;
+  if (canceled)
+    {
+      list_remove (&w->elem);
+      w->pending = false;
+    }
+  intr_set_level (old_level);
+  return canceled;
+}
+
+/* Worker thread.  Runs queued work, one item at a time, at the
+   item's priority, and wakes drainers once the queue goes idle. */
+static void
+worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w;
+      work_func *func;
+      void *func_aux;
+      int priority;
+
+      sema_down (&queue_sema);
+
+      old_level = intr_disable ();
+      if (list_empty (&queue))
+        {
+          intr_set_level (old_level);
+          continue;
+        }
+      w = list_entry (list_pop_front (&queue), struct work, elem);
+      w->pending = false;
+      func = w->func;
+      func_aux = w->aux;
+      priority = w->priority;
+      busy_cnt++;
+      intr_set_level (old_level);
+
+      /* W may be freed or resubmitted from here on. */
+      if (!thread_mlfqs && priority != thread_current ()->base_priority)
+        thread_set_priority (priority);
+      func (func_aux);
+
+      old_level = intr_disable ();
+      busy_cnt--;
+      if (busy_cnt == 0 && list_empty (&queue))
+        for (; drain_cnt > 0; drain_cnt--)
+          sema_up (&drain_sema);
+      intr_set_level (old_level);
+    }
+}
+
+/* Returns true if work A_ should run before work B_. */
+static bool
+work_more_priority (const struct list_elem *a_, const struct list_elem *b_,
+                    void *aux UNUSED)
+{
+  const struct work *a = list_entry (a_, struct work, elem);
+  const struct work *b = list_entry (b_, struct work, elem);
+
+  return a->priority > b->priority;
+}
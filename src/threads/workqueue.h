@@ -0,0 +1,38 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Kernel work queue.
+
+   Deferred work is described by a struct work and handed to
+   work_submit(), which queues it for a small, fixed pool of
+   kernel worker threads.  Higher-priority work runs first, and
+   each item runs at its own priority, so background work such
+   as writing back the buffer cache need not own a thread.
+
+   A work item's function runs in a kernel thread, so it may
+   sleep and acquire locks.  The struct work must stay valid
+   until its function starts running or it is canceled; the
+   function itself may free it or submit it again. */
+typedef void work_func (void *aux);
+
+struct work
+  {
+    struct list_elem elem;      /* Element in the work queue. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    int priority;               /* Priority to run at. */
+    bool pending;               /* Queued and not yet started? */
+  };
+
+void workqueue_init (void);
+void workqueue_drain (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_submit (struct work *, int priority);
+bool work_pending (const struct work *);
+bool work_cancel (struct work *);
+
+#endif /* threads/workqueue.h */
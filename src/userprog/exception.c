@@ -4,6 +4,7 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 #ifdef VM
 #include "vm/page.h"
 #endif
@@ -150,11 +151,22 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 #ifdef VM
-  /* Allow the page handle it. */
-  if(user && not_present && !page_in(fault_addr))
-     thread_exit();
-  if((f->error_code & PF_U) != 0 && (f->error_code & PF_P) == 0)
-     return;
+  /* A write to a copy-on-write page, from the process itself or
+     from a system call writing into its buffer. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_cow (fault_addr))
+    return;
+
+  /* Bring in a page of the process that is not yet in memory,
+     whether the process touched it or a system call copying to
+     or from its memory did. */
+  if (not_present && is_user_vaddr (fault_addr))
+    {
+      if (page_in (fault_addr, write))
+        return;
+      if (user)
+        thread_exit ();
+    }
 #endif
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
@@ -8,6 +8,7 @@
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -151,10 +152,58 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
     }
 }
 
+/* Starts a batch of pages to be cleared from PD with
+   pagedir_batch_clear(), whose TLB entries are invalidated
+   together by pagedir_batch_end(). */
+void
+pagedir_batch_begin (struct pagedir_batch *b, uint32_t *pd)
+{
+  b->pd = pd;
+  b->cnt = 0;
+}
+
+/* Marks user virtual page UPAGE "not present" in B's page
+   directory, like pagedir_clear_page(), but leaves its TLB entry
+   to be invalidated by pagedir_batch_end().  Until then the
+   caller must not access UPAGE. */
+void
+pagedir_batch_clear (struct pagedir_batch *b, void *upage)
+{
+  uint32_t *pte;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  pte = lookup_page (b->pd, upage, false);
+  if (pte != NULL && (*pte & PTE_P) != 0)
+    {
+      *pte &= ~PTE_P;
+      if (b->cnt < PAGEDIR_BATCH_PAGES)
+        b->pages[b->cnt] = upage;
+      b->cnt++;
+    }
+}
+
+/* Invalidates the TLB entries of the pages cleared in batch B:
+   one by one for a small batch, or by flushing the whole TLB
+   once for a large one. */
+void
+pagedir_batch_end (struct pagedir_batch *b)
+{
+  size_t i;
+
+  if (b->cnt > PAGEDIR_BATCH_PAGES)
+    invalidate_pagedir (b->pd);
+  else
+    for (i = 0; i < b->cnt; i++)
+      invalidate_page (b->pd, b->pages[i]);
+  b->cnt = 0;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -179,7 +228,26 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
+        }
+    }
+}
+
+/* Sets the writable bit to WRITABLE in the PTE for virtual page
+   VPAGE in PD.  Other bits in the page table entry are
+   preserved. */
+void
+pagedir_set_writable (uint32_t *pd, const void *vpage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        {
+          *pte &= ~(uint32_t) PTE_W;
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -208,7 +276,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -260,3 +328,14 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Invalidates the TLB entry for user virtual page UPAGE if PD is
+   the active page directory, which is much cheaper than flushing
+   the whole TLB with invalidate_pagedir().  See [IA32-v2a]
+   "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *upage)
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (upage) : "memory");
+}
@@ -2,15 +2,33 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Largest batch whose pages are invalidated one at a time;
+   larger batches flush the whole TLB instead. */
+#define PAGEDIR_BATCH_PAGES 32
+
+/* Pages cleared from a page directory whose TLB entries have not
+   been invalidated yet. */
+struct pagedir_batch
+  {
+    uint32_t *pd;                       /* Page directory. */
+    size_t cnt;                         /* Number of pages cleared. */
+    void *pages[PAGEDIR_BATCH_PAGES];   /* The first pages cleared. */
+  };
+
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+void pagedir_batch_begin (struct pagedir_batch *, uint32_t *pd);
+void pagedir_batch_clear (struct pagedir_batch *, void *upage);
+void pagedir_batch_end (struct pagedir_batch *);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
+void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
@@ -19,6 +19,12 @@
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/futex.h"
+#include "vm/page.h"
+#include "vm/region.h"
+#endif
+#include "userprog/syscall.h"
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
@@ -46,7 +52,7 @@ process_execute (const char *file_name)
   // token out the argument
   char *token, *save_ptr;
   token = strtok_r(fn_copy2, " ", &save_ptr);
-  tid = thread_create (token, PRI_DEFAULT, start_process, fn_copy);
+  tid = thread_create_child (token, PRI_DEFAULT, start_process, fn_copy);
 
   if (tid == TID_ERROR){
     free (fn_copy);
@@ -84,13 +90,6 @@ start_process (void *file_name_)
   int argv[128];
   
   struct thread *cur = thread_current();
-  
-  // lock the elffile file that belongs to thread_current()
-  acquire_file_lock();
-  cur->elffile = filesys_open(token);
-  // once elffile file is opened, deny other writing requests
-  if(cur->elffile != NULL) file_deny_write(cur->elffile);
-  release_file_lock();
 
   cur->parent->load_status = success;
 
@@ -136,165 +135,419 @@ start_process (void *file_name_)
   NOT_REACHED ();
 }
 
-/* Waits for thread TID to die and returns its exit status.  If
-   it was terminated by the kernel (i.e. killed due to an
-   exception), returns -1.  If TID is invalid or if it was not a
-   child of the calling process, or if process_wait() has already
-   been successfully called for the given TID, returns -1
-   immediately, without waiting. */
-int
-process_wait (tid_t child_tid)
+#ifdef VM
+/* Data handed from a forking process to its child. */
+struct fork_info
+  {
+    struct thread *parent;      /* Forking process. */
+    struct intr_frame if_;      /* Parent's user register state. */
+  };
+
+static thread_func fork_process NO_RETURN;
+static bool fork_copy_files (struct thread *parent);
+
+/* Creates a child process that is a copy of the current one,
+   resuming from the system call whose user register state is in
+   F.  The address space is shared copy-on-write.  Returns the
+   child's thread id, or TID_ERROR if it cannot be created. */
+tid_t
+process_fork (struct intr_frame *f)
 {
-    int a = child_tid;
-    int ret_status;
-    struct thread *ts = thread_current();
-    struct thread *sb = NULL;
-    struct list_elem *e;
-    /* check whether is in the children list . */
-    if (ts == NULL) {
-        for (e = list_begin(&ts->child_list); e != list_end(&ts->child_list); e = list_next(e)) {
-            sb = list_entry(e, struct thread, childelem);
-            if (sb->tid == child_tid) {
-                sema_down(&sb->wsem);
-                sb->awaited = true;
-                break;
-            }
-        }
-    } else {
-        for (;;) {
-            struct wsem *cs = list_entry(e, struct wsem, wsem_elem);
+  struct thread *cur = thread_current ();
+  struct fork_info *info;
+  tid_t tid;
 
-                int count=cs->tid;
+  /* The child would get a copy of only the forking thread. */
+  if (cur != cur->process || cur->uthread_cnt > 0)
+    return TID_ERROR;
 
-                if (count != 0) {
-                    count = --cs->ref_cnt;
-                    }
-                    free(cs);
-                    break;
-            }
+  info = malloc (sizeof *info);
+  if (info == NULL)
+    return TID_ERROR;
+  info->parent = cur;
+  info->if_ = *f;
 
+  tid = thread_create_child (cur->name, cur->priority, fork_process, info);
+  if (tid == TID_ERROR)
+    {
+      free (info);
+      return tid;
     }
-  struct list *l = &thread_current()->child_list;
-  struct thread *t=NULL;
-
-  int status = -1;
-
-  thread_wait(t,child_tid);
-  struct wsem *child = NULL;
-  for (e = list_begin(l); e != list_end(l); e = list_next(e)) {
-    child = list_entry(e, struct wsem, wsem_elem);
-    if(child->tid == child_tid) {
-      status = child->ret_status;
-      break;
+
+  /* Stay blocked while the child copies our address space. */
+  sema_down (&cur->esem);
+  if (!cur->load_status)
+    return TID_ERROR;
+  return tid;
+}
+
+/* A thread function that duplicates the forking process given
+   in INFO_ and returns to user mode with a return value of 0. */
+static void
+fork_process (void *info_)
+{
+  struct fork_info *info = info_;
+  struct thread *parent = info->parent;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_ = info->if_;
+  bool success = false;
+
+  free (info);
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir != NULL)
+    {
+      process_activate ();
+      success = fork_copy_files (parent) && page_fork (parent);
     }
-  }
-  /* if pid is not in its children list, return immediately. */
-  if (e == list_end(&t->child_list)) {
-      return -1;
-  }
-  list_remove(e);
-  free(child);
-  
-  return status;
-  /* Since one process will not wait for its child process twice. So we can remove the child process from its
-  children list. So that we can return immediately next time when we want to wait for the same child process
-  twice since it is no longer in the children list.. Morever, generally, the child process should actually exit
-  when its parent process is exit, since
-  there is no need to maintain its exit status, their parent is dead and no one will look up its exit status*/
-  if (t == NULL) {
-      list_remove(&t->childelem);
-      ret_status = t->ret_status;
-      sema_up(&t->tsem);
-  }
-  return -1;
+
+  parent->load_status = success;
+  sema_up (&parent->esem);
+  if (!success)
+    thread_exit ();
+
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
 }
 
-/* Free the current process's resources. */
-void
-process_exit (void)
+/* Gives the current thread its own handles on PARENT's
+   executable, open files and working directory.  Returns true if
+   successful, false on failure. */
+static bool
+fork_copy_files (struct thread *parent)
 {
   struct thread *cur = thread_current ();
-  struct thread *child = NULL;
   struct list_elem *e;
-  struct list_elem *next;
-  uint32_t *pd;
+  bool success = true;
 
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
-  pd = cur->pagedir;
-   #ifdef VM
-          /* If its parent is waiting for it. Wake up the parent process. */
-        sema_up(&cur->wsem);
-        cur->awaited = false;
-        lock_acquire(&fl);
-        /* close the executable file. */
-        if (cur->elffile != NULL) {
-            file_close(cur->elffile);
+  acquire_file_lock ();
+  cur->elffile = file_reopen (parent->elffile);
+  if (cur->elffile == NULL)
+    success = false;
+  else
+    file_deny_write (cur->elffile);
+
+  for (e = list_begin (&parent->fds); success && e != list_end (&parent->fds);
+       e = list_next (e))
+    {
+      struct file_node *pn = list_entry (e, struct file_node, file_elem);
+      struct file_node *fn = malloc (sizeof *fn);
+      if (fn == NULL)
+        {
+          success = false;
+          break;
         }
-        lock_release(&fl);
-    } else {
-        printf("%s: exit(%d)\n", cur->name, cur->ret_status);
-
-        /* Notify parent that we're dead. */
-        if (cur->wsem != NULL) {
-            struct wsem *cs = cur->wsem;
-            int count;
-            cs->exit_code = cur->ret_status;
-            sema_up(&cs->dead);
-            lock_acquire(&cs->lock);
-            count = --cs->ref_cnt;
-            lock_release(&cs->lock);
-
-            if (count != 0) {
-                lock_acquire(&cs->lock);
-                cs->ref_cnt = count;
-                lock_release(&cs->lock);
-            } else
-                free(cs);
+      fn->fd = pn->fd;
+      fn->read_dir_cnt = pn->read_dir_cnt;
+      fn->file = file_reopen (pn->file);
+      if (fn->file == NULL)
+        {
+          free (fn);
+          success = false;
+          break;
         }
+      file_seek (fn->file, file_tell (pn->file));
+      list_push_back (&cur->fds, &fn->file_elem);
+    }
+  cur->next_handle = parent->next_handle;
+  release_file_lock ();
 
-        /* Free entries of children list. */
-        for (e = list_begin(&cur->child_list); e != list_end(&cur->child_list); e = next) {
-            struct wsem *cs = list_entry(e, struct wsem, elem);
-            int count;
-            next = list_remove(e);
-
-            lock_acquire(&cs->lock);
-            count = --cs->ref_cnt;
-            lock_release(&cs->lock);
-
-            if (count != 0) {
-                lock_acquire(&cs->lock);
-                cs->ref_cnt = count;
-                lock_release(&cs->lock);
-            } else
-                free(cs);
-        }
+  if (parent->curr_dir != NULL)
+    cur->curr_dir = dir_reopen (parent->curr_dir);
+  return success;
+}
+
+/* Maximum number of threads started by thread_create() that a
+   process may have at once, limited by `stack_slots'. */
+#define UTHREAD_MAX 32
+
+/* Size of each such thread's user stack, in pages.  The stacks
+   sit one after another below the main thread's 1 MB stack. */
+#define UTHREAD_STACK_PAGES 16
+#define UTHREAD_STACK_SIZE (UTHREAD_STACK_PAGES * PGSIZE)
+
+/* Data handed from process_thread_create() to the new thread. */
+struct uthread_info
+  {
+    struct thread *process;     /* Main thread of the process. */
+    struct uthread *uthread;    /* Join record. */
+    void (*start) (void);       /* User entry point. */
+    void *func, *aux;           /* Arguments for START. */
+    uint8_t *stack;             /* Top of the user stack. */
+  };
+
+static thread_func uthread_start NO_RETURN;
+
+/* Returns the top of the user stack in stack slot SLOT. */
+static uint8_t *
+uthread_stack (int slot)
+{
+  return (uint8_t *) PHYS_BASE - 1024 * 1024 - slot * UTHREAD_STACK_SIZE;
+}
+
+/* Starts a thread in the current process that enters user mode
+   at START, as if START (FUNC, AUX) had been called, on a stack
+   of its own.  Returns the new thread's id, or TID_ERROR if it
+   cannot be created. */
+tid_t
+process_thread_create (void (*start) (void), void *func, void *aux)
+{
+  struct thread *cur = thread_current ();
+  struct thread *proc = cur->process;
+  struct uthread_info *info;
+  struct uthread *rec;
+  enum intr_level old_level;
+  int slot;
+  tid_t tid;
+
+  info = malloc (sizeof *info);
+  rec = malloc (sizeof *rec);
+  if (info == NULL || rec == NULL)
+    goto fail;
+
+  /* Claim a stack slot and reserve its pages. */
+  old_level = intr_disable ();
+  for (slot = 0; slot < UTHREAD_MAX; slot++)
+    if ((proc->stack_slots & (1u << slot)) == 0)
+      {
+        proc->stack_slots |= 1u << slot;
+        break;
+      }
+  intr_set_level (old_level);
+  if (slot == UTHREAD_MAX)
+    goto fail;
+  if (region_add (uthread_stack (slot) - UTHREAD_STACK_SIZE,
+                  UTHREAD_STACK_PAGES, NULL, 0, 0, false, true) == NULL)
+    goto fail_slot;
+
+  rec->tid = TID_ERROR;
+  rec->slot = slot;
+  rec->status = -1;
+  rec->exited = false;
+  rec->joined = false;
+  sema_init (&rec->dead, 0);
+  info->process = proc;
+  info->uthread = rec;
+  info->start = start;
+  info->func = func;
+  info->aux = aux;
+  info->stack = uthread_stack (slot);
+
+  old_level = intr_disable ();
+  list_push_back (&proc->uthreads, &rec->elem);
+  proc->uthread_cnt++;
+  intr_set_level (old_level);
+
+  tid = thread_create (cur->name, cur->priority, uthread_start, info);
+  if (tid != TID_ERROR)
+    {
+      rec->tid = tid;
+      return tid;
+    }
 
-        /* Destroy the page hash table. */
-        page_exit();
+  old_level = intr_disable ();
+  list_remove (&rec->elem);
+  proc->uthread_cnt--;
+  intr_set_level (old_level);
+  region_remove (region_find (uthread_stack (slot) - 1));
+ fail_slot:
+  old_level = intr_disable ();
+  proc->stack_slots &= ~(1u << slot);
+  intr_set_level (old_level);
+ fail:
+  free (info);
+  free (rec);
+  return TID_ERROR;
+}
+
+/* A thread function that joins the process given in INFO_ and
+   enters user mode. */
+static void
+uthread_start (void *info_)
+{
+  struct uthread_info info = *(struct uthread_info *) info_;
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+  uint32_t *esp = (uint32_t *) info.stack;
+
+  free (info_);
+  cur->process = info.process;
+  cur->uthread = info.uthread;
+  cur->pagedir = info.process->pagedir;
+  process_activate ();
+
+  /* Push START's arguments and a null return address. */
+  if (!page_lock (esp - 1, true))
+    thread_exit ();
+  *--esp = (uint32_t) info.aux;
+  *--esp = (uint32_t) info.func;
+  *--esp = 0;
+  page_unlock (esp);
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = info.start;
+  if_.esp = esp;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
 
-        /* Close executable (and allow writes). */
-        file_close(cur->elffile);
+/* Ends the current thread with exit status STATUS for
+   process_thread_join().  In a process's main thread, ends the
+   process instead. */
+void
+process_thread_exit (int status)
+{
+  struct thread *cur = thread_current ();
 
-        /* Destroy the current process's page directory and switch back
-           to the kernel-only page directory. */
-        pd = cur->pagedir;
+  if (cur->uthread != NULL)
+    {
+      cur->uthread->status = status;
+      cur->uthread->exited = true;
     }
+  else
+    cur->ret_status = status;
+  thread_exit ();
+}
+
+/* Waits for thread TID of the current process, started by
+   process_thread_create(), to end and returns the status it
+   passed to process_thread_exit().  Returns -1 at once if TID is
+   no such thread, is the caller, or is already being joined. */
+int
+process_thread_join (tid_t tid)
+{
+  struct thread *cur = thread_current ();
+  struct thread *proc = cur->process;
+  struct uthread *rec = NULL;
+  struct list_elem *e;
+  enum intr_level old_level;
+  int status;
 
-    for (e = list_begin (&cur->child_list); e != list_end (&cur->child_list);
-         e = list_next (e))
+  old_level = intr_disable ();
+  for (e = list_begin (&proc->uthreads); e != list_end (&proc->uthreads);
+       e = list_next (e))
     {
-        child = list_entry (e, struct thread, childelem);
+      struct uthread *u = list_entry (e, struct uthread, elem);
+      if (u->tid == tid && !u->joined && u != cur->uthread)
+        {
+          rec = u;
+          rec->joined = true;
+          break;
+        }
+    }
+  intr_set_level (old_level);
+  if (rec == NULL)
+    return -1;
+
+  sema_down (&rec->dead);
+  status = rec->status;
+  old_level = intr_disable ();
+  list_remove (&rec->elem);
+  intr_set_level (old_level);
+  free (rec);
+  return status;
+}
 
-        /* Tell all of its child process that they are free to exit because their parent process is dead. There is no
-         parent process need to wait for their exit status.. */
-        sema_up (&child->tsem);
+/* Releases the resources of a thread started by
+   process_thread_create() and reports its end.  If it ended by
+   any means but process_thread_exit(), the whole process exits
+   with its status. */
+static void
+uthread_exit (void)
+{
+  struct thread *cur = thread_current ();
+  struct thread *proc = cur->process;
+  struct uthread *rec = cur->uthread;
+  struct pagedir_batch batch;
+  uint8_t *top = uthread_stack (rec->slot);
+  uint8_t *upage;
+  enum intr_level old_level;
+
+  if (!rec->exited && !proc->exiting)
+    {
+      proc->ret_status = cur->ret_status;
+      proc->exiting = true;
+      futex_exit (proc);
     }
 
-    /* try to exit completely . */
-    sema_down(&cur->tsem);
-  #endif
+  pagedir_batch_begin (&batch, cur->pagedir);
+  for (upage = top - UTHREAD_STACK_SIZE; upage < top; upage += PGSIZE)
+    if (page_find (upage) != NULL)
+      page_deallocate (upage, &batch);
+  pagedir_batch_end (&batch);
+  region_remove (region_find (top - 1));
+
+  cur->pagedir = NULL;
+  pagedir_activate (NULL);
+
+  /* PROC may exit, and a joiner free REC, as soon as we block. */
+  old_level = intr_disable ();
+  proc->stack_slots &= ~(1u << rec->slot);
+  proc->uthread_cnt--;
+  sema_up (&rec->dead);
+  sema_up (&proc->uthread_sema);
+  intr_set_level (old_level);
+}
+
+/* Ends the other threads of the current process, which must be
+   its main thread, and waits for them to finish exiting. */
+static void
+uthread_exit_all (void)
+{
+  struct thread *cur = thread_current ();
+
+  if (list_empty (&cur->uthreads))
+    return;
+  cur->exiting = true;
+  futex_exit (cur);
+  while (cur->uthread_cnt > 0)
+    sema_down (&cur->uthread_sema);
+  while (!list_empty (&cur->uthreads))
+    free (list_entry (list_pop_front (&cur->uthreads), struct uthread, elem));
+}
+#endif
+
+/* Waits for thread TID to die and returns its exit status.  If
+   it was terminated by the kernel (i.e. killed due to an
+   exception), returns -1.  If TID is invalid or if it was not a
+   child of the calling process, or if process_wait() has already
+   been successfully called for the given TID, returns -1
+   immediately, without waiting. */
+int
+process_wait (tid_t child_tid)
+{
+  return thread_wait (child_tid);
+}
+
+/* Free the current process's resources. */
+void
+process_exit (void)
+{
+  struct thread *cur = thread_current ();
+  uint32_t *pd;
+
+#ifdef VM
+  /* Everything but the stack belongs to the main thread. */
+  if (cur->uthread != NULL)
+    {
+      uthread_exit ();
+      return;
+    }
+  uthread_exit_all ();
+
+  /* Write dirty mapped pages back to their files, then release
+     every page and frame while the page directory still records
+     which pages are dirty. */
+  mmap_exit ();
+  page_exit ();
+#endif
+
+  /* Destroy the current process's page directory and switch back
+     to the kernel-only page directory. */
+  pd = cur->pagedir;
   if (pd != NULL)
     {
       /* Correct ordering here is crucial.  We must set
@@ -308,7 +561,6 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
-
 }
 
 /* Sets up the CPU for running user code in the current
@@ -417,6 +669,15 @@ load (const char *file_name, void (**eip) (void), void **esp)
     goto done;
   process_activate ();
 
+#ifdef VM
+  /* Create the supplemental page table. */
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    goto done;
+  hash_init (t->pages, page_hash, page_less, NULL);
+  region_init (&t->regions);
+#endif
+
   /* Open executable file. */
   acquire_file_lock();
   file = filesys_open (file_name);
@@ -505,11 +766,16 @@ load (const char *file_name, void (**eip) (void), void **esp)
   /* Start address. */
   *eip = (void (*) (void)) ehdr.e_entry;
 
+  /* Segments are paged in from FILE on demand, so keep it open
+     (and unwritable) for the lifetime of the process. */
+  file_deny_write (file);
+  t->elffile = file;
   success = true;
 
  done:
   /* We arrive here whether the load is successful or not. */
-  file_close(file);
+  if (!success)
+    file_close (file);
   release_file_lock();
   return success;
 }
@@ -585,6 +851,15 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  /* Record the whole segment as one region.  Nothing is read
+     here: page_in() brings each page in on its first access, and
+     pages past READ_BYTES are zero-filled without touching the
+     disk. */
+  return region_add (upage, (read_bytes + zero_bytes) / PGSIZE,
+                     read_bytes > 0 ? file : NULL, ofs, read_bytes,
+                     !writable, writable) != NULL;
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0)
     {
@@ -617,10 +892,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
-      ofs += page_read_bytes;
       upage += PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Reverse the order of the ARGC pointers to char in ARGV. */
@@ -657,6 +932,18 @@ static void *push(uint8_t *kpage, size_t *ofs, const void *buf, size_t size) {
 static bool
 setup_stack (void **esp)
 {
+#ifdef VM
+  uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
+
+  /* The kernel writes the arguments here before the process
+     runs, so fault the first stack page in right away. */
+  if (page_allocate (upage, false) == NULL || !page_lock (upage, true))
+    return false;
+  page_unlock (upage);
+
+  *esp = PHYS_BASE;
+  return true;
+#else
   uint8_t *kpage;
   bool success = false;
 
@@ -670,6 +957,7 @@ setup_stack (void **esp)
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 /* Create a minimal stack by mapping a zeroed page at the top of
    user virtual memory. */
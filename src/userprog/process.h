@@ -1,9 +1,14 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include "threads/interrupt.h"
 #include "threads/thread.h"
 
 tid_t process_execute (const char *file_name);
+tid_t process_fork (struct intr_frame *);
+tid_t process_thread_create (void (*start) (void), void *func, void *aux);
+void process_thread_exit (int status) NO_RETURN;
+int process_thread_join (tid_t);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
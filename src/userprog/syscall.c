@@ -1,12 +1,16 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <round.h>
+#include <string.h>
+#include <clock.h>
 #include <syscall-nr.h>
 #include "filesys/filesys.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
 #include "devices/input.h"
+#include "devices/timer.h"
 #include "threads/vaddr.h"
 #include "threads/palloc.h"
 #include "userprog/pagedir.h"
@@ -15,8 +19,12 @@
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
 #include "vm/page.h"
+#include "vm/region.h"
+#include "vm/futex.h"
 #include "filesys/directory.h"
 #include "filesys/cache.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
 
 // syscall array
 syscall_function syscalls[SYSCALL_NUMBER];
@@ -48,6 +56,10 @@ syscall_init (void)
   syscalls[SYS_SEEK] = sys_seek;
   syscalls[SYS_TELL] = sys_tell;
   syscalls[SYS_CLOSE] = sys_close;
+#ifdef VM
+  syscalls[SYS_MMAP] = sys_mmap;
+  syscalls[SYS_MUNMAP] = sys_munmap;
+#endif
   /*those are syscall pro4 need*/
   syscalls[SYS_CHDIR] = sys_CHDIR;  /* Change the current directory. */
   syscalls[SYS_MKDIR] = sys_MKDIR;  /* Create a directory. */
@@ -56,14 +68,37 @@ syscall_init (void)
   syscalls[SYS_INUMBER] = sys_INUMBER; /* Returns the inode number for a fd. */
   /* For cache test */
   syscalls[SYS_CACHE_FLUSH] = sys_CACHE_FLUSH; /* Cache flash to disk, return the number of flash block*/ 
+#ifdef VM
+  syscalls[SYS_FORK] = sys_fork;
+  syscalls[SYS_VMSTAT] = sys_vmstat;
+  syscalls[SYS_MADVISE] = sys_madvise;
+  syscalls[SYS_MLOCK] = sys_mlock;
+  syscalls[SYS_MUNLOCK] = sys_munlock;
+  syscalls[SYS_FUTEX_WAIT] = sys_futex_wait;
+  syscalls[SYS_FUTEX_WAKE] = sys_futex_wake;
+  syscalls[SYS_THREAD_CREATE] = sys_thread_create;
+  syscalls[SYS_THREAD_EXIT] = sys_thread_exit;
+  syscalls[SYS_THREAD_JOIN] = sys_thread_join;
+  syscalls[SYS_CLOCK_GETTIME] = sys_clock_gettime;
+#endif
+}
+
+// check whether user page p is mapped, bringing it in first if
+// it belongs to the process but has not been touched yet
+static bool page_mapped(void *p) {
+  if (pagedir_get_page(thread_current()->pagedir, p) != NULL)
+    return true;
+#ifdef VM
+  return page_in(p, false);
+#else
+  return false;
+#endif
 }
 
 // check whether page p and p+3 has been in kernel virtual memory
 void check_page(void *p) {
-  void *pagedir = pagedir_get_page(thread_current()->pagedir, p);
-  if(pagedir == NULL) exit(-1);
-  pagedir = pagedir_get_page(thread_current()->pagedir, p + 3);
-  if(pagedir == NULL) exit(-1);
+  if(!page_mapped(p)) exit(-1);
+  if(!page_mapped(p + 3)) exit(-1);
 }
 
 // check whether page p and p+3 is a user virtual address
@@ -165,7 +200,7 @@ void sys_open(struct intr_frame * f) {
   check_func_args((void *)(p + 1), 1);
   check((void*)*(p + 1));
 
-  struct thread * t = thread_current();
+  struct thread * t = thread_process();
   acquire_file_lock();
   struct file * open_f = filesys_open((const char *)*(p + 1));
   release_file_lock();
@@ -185,7 +220,7 @@ void sys_open(struct intr_frame * f) {
 void sys_filesize(struct intr_frame * f) {
   int * p =f->esp;
   check_func_args((void *)(p + 1), 1);
-  struct file_node * open_f = find_file(&thread_current()->fds, *(p + 1));
+  struct file_node * open_f = find_file(&thread_process()->fds, *(p + 1));
   // check whether the write file is valid
   if (open_f){
     acquire_file_lock();
@@ -210,7 +245,7 @@ void sys_read(struct intr_frame * f) {
     f->eax = size;
   }
   else{
-    struct file_node * open_f = find_file(&thread_current()->fds, *(p + 1));
+    struct file_node * open_f = find_file(&thread_process()->fds, *(p + 1));
     // check whether the read file is valid
     if (open_f){
        if(!file_validate(open_f->file)){
@@ -238,7 +273,7 @@ void sys_write(struct intr_frame * f) {
     f->eax = size2;
   }
   else{
-    struct file_node * openf = find_file(&thread_current()->fds, *(p + 1));
+    struct file_node * openf = find_file(&thread_process()->fds, *(p + 1));
     // check whether the write file is valid
     if (openf){
       acquire_file_lock();
@@ -257,7 +292,7 @@ void sys_write(struct intr_frame * f) {
 void sys_seek(struct intr_frame * f) {
   int * p =f->esp;
   check_func_args((void *)(p + 1), 2);
-  struct file_node * openf = find_file(&thread_current()->fds, *(p + 1));
+  struct file_node * openf = find_file(&thread_process()->fds, *(p + 1));
   if (openf){
     acquire_file_lock();
     file_seek(openf->file, *(p + 2));
@@ -268,7 +303,7 @@ void sys_seek(struct intr_frame * f) {
 void sys_tell(struct intr_frame * f) {
   int * p =f->esp;
   check_func_args((void *)(p + 1), 1);
-  struct file_node * open_f = find_file(&thread_current()->fds, *(p + 1));
+  struct file_node * open_f = find_file(&thread_process()->fds, *(p + 1));
   // check whether the tell file is valid
   if (open_f){
     acquire_file_lock();
@@ -281,7 +316,7 @@ void sys_tell(struct intr_frame * f) {
 void sys_close(struct intr_frame * f) {
   int *p = f->esp;
   check_func_args((void *)(p + 1), 1);
-  struct file_node * openf = find_file(&thread_current()->fds, *(p + 1));
+  struct file_node * openf = find_file(&thread_process()->fds, *(p + 1));
   if (openf){
     acquire_file_lock();
     file_close(openf->file);
@@ -294,6 +329,101 @@ void sys_close(struct intr_frame * f) {
 
 
 
+#ifdef VM
+// search the mapping list of thread_current()
+// to get the mapping has corresponding handle
+static struct mapping *find_mapping(int handle) {
+  struct list *l = &thread_process()->mappings;
+  struct list_elem *e;
+  for (e = list_begin(l); e != list_end(l); e = list_next(e)) {
+    struct mapping *m = list_entry(e, struct mapping, elem);
+    if (m->handle == handle)
+      return m;
+  }
+  return NULL;
+}
+
+// remove mapping M, writing its dirty pages back to the file.
+// Pages are visited in address order, which is also file order,
+// so the writebacks reach the file sequentially.
+// Pages never touched have no page to write back.  The TLB is
+// invalidated once for the whole mapping rather than per page.
+static void unmap(struct mapping *m) {
+  struct pagedir_batch batch;
+  size_t i;
+  list_remove(&m->elem);
+  pagedir_batch_begin(&batch, thread_current()->pagedir);
+  for (i = 0; i < m->page_cnt; i++)
+    if (page_find(m->base + i * PGSIZE) != NULL)
+      page_deallocate(m->base + i * PGSIZE, &batch);
+  pagedir_batch_end(&batch);
+  region_remove(region_find(m->base));
+  acquire_file_lock();
+  file_close(m->file);
+  release_file_lock();
+  free(m);
+}
+
+void sys_mmap(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  struct thread *t = thread_process();
+  struct file_node *fn = find_file(&t->fds, *(p + 1));
+  uint8_t *addr = (uint8_t *)*(p + 2);
+  struct mapping *m;
+  off_t length;
+
+  f->eax = -1;
+  if (fn == NULL || addr == NULL || pg_ofs(addr) != 0)
+    return;
+  m = malloc(sizeof *m);
+  if (m == NULL)
+    return;
+
+  acquire_file_lock();
+  m->file = file_reopen(fn->file);
+  length = m->file != NULL ? file_length(m->file) : 0;
+  release_file_lock();
+  if (length <= 0) {
+    acquire_file_lock();
+    file_close(m->file);
+    release_file_lock();
+    free(m);
+    return;
+  }
+
+  // only record the region: nothing is read until its pages fault in
+  m->handle = t->next_handle++;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP(length, PGSIZE);
+  if (region_add(addr, m->page_cnt, m->file, 0, length, false, false)
+      == NULL) {
+    acquire_file_lock();
+    file_close(m->file);
+    release_file_lock();
+    free(m);
+    return;
+  }
+  list_push_back(&t->mappings, &m->elem);
+  f->eax = m->handle;
+}
+
+void sys_munmap(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+  struct mapping *m = find_mapping(*(p + 1));
+  if (m != NULL)
+    unmap(m);
+}
+
+/* Removes all of the current process's memory mappings. */
+void mmap_exit(void) {
+  struct list *l = &thread_process()->mappings;
+  while (!list_empty(l))
+    unmap(list_entry(list_front(l), struct mapping, elem));
+}
+#endif
+
 /* Project 4 only. */
 void sys_CHDIR(struct intr_frame *f){
   /* Change the current directory. */
@@ -320,7 +450,7 @@ void sys_READDIR(struct intr_frame *f){
   int fd = *(p + 1);
   const char * dir_name = (const char *)*(p + 2);
 
-  struct file_node * openf = find_file(&thread_current()->fds, fd);
+  struct file_node * openf = find_file(&thread_process()->fds, fd);
   bool ok;
   if(openf!=NULL){
     openf->read_dir_cnt ++;
@@ -337,7 +467,7 @@ void sys_ISDIR(struct intr_frame *f){
   /* Tests if a fd represents a directory. */
   int * p =f->esp;
   int fd = *(p + 1);
-  struct file_node * openf = find_file(&thread_current()->fds, fd);
+  struct file_node * openf = find_file(&thread_process()->fds, fd);
   // check whether the write file is valid
   if (openf){
     f->eax = !file_validate(openf->file);
@@ -351,7 +481,7 @@ void sys_INUMBER(struct intr_frame *f){
   /* Returns the inode number for a fd. */
   int * p =f->esp;
   int fd = *(p + 1);
-  struct file_node * openf = find_file(&thread_current()->fds, fd);
+  struct file_node * openf = find_file(&thread_process()->fds, fd);
   // check whether the write file is valid
   if (openf){
     f->eax = file_get_inumber(openf->file);
@@ -361,3 +491,132 @@ void sys_INUMBER(struct intr_frame *f){
 void sys_CACHE_FLUSH(struct intr_frame *f) {
   f->eax = cache_examine();
 }
+
+void sys_fork(struct intr_frame *f) {
+  f->eax = process_fork(f);
+}
+
+#ifdef VM
+// copy SIZE bytes from SRC out to user memory at UDST, at most
+// a page, keeping the destination pages in memory while writing
+// them.  Returns false if UDST is not writable user memory.
+static bool copy_out(void *udst, const void *src, size_t size) {
+  uint8_t *first = pg_round_down(udst);
+  uint8_t *last = pg_round_down((uint8_t *)udst + size - 1);
+
+  ASSERT(size > 0 && size <= PGSIZE);
+  if (udst == NULL || !is_user_vaddr((uint8_t *)udst + size)
+      || !page_lock(first, true))
+    return false;
+  if (last != first && !page_lock(last, true)) {
+    page_unlock(first);
+    return false;
+  }
+  memcpy(udst, src, size);
+  if (last != first)
+    page_unlock(last);
+  page_unlock(first);
+  return true;
+}
+
+// copy the process's VM statistics out to user memory
+void sys_vmstat(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+  struct vmstat *stat = (struct vmstat *)*(p + 1);
+
+  f->eax = copy_out(stat, &thread_process()->vmstat, sizeof *stat);
+}
+
+// apply an access hint to a page-aligned range of user memory
+void sys_madvise(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 3);
+  uint8_t *addr = (uint8_t *)*(p + 1);
+  unsigned length = *(p + 2);
+  uint8_t *end = addr + ROUND_UP(length, PGSIZE);
+
+  f->eax = -1;
+  if (pg_ofs(addr) != 0 || end < addr || !is_user_vaddr(end - 1))
+    return;
+  if (page_madvise(addr, end, *(p + 3)))
+    f->eax = 0;
+}
+
+// get the user range of pages covering [*(p + 1), *(p + 1) + *(p + 2)),
+// returning false if it is not entirely in user space
+static bool user_range(int *p, uint8_t **start, uint8_t **end) {
+  uint8_t *addr = (uint8_t *)*(p + 1);
+  unsigned length = *(p + 2);
+  *start = pg_round_down(addr);
+  *end = (uint8_t *)ROUND_UP((uintptr_t)addr + length, PGSIZE);
+  return *end >= *start && (*end == *start || is_user_vaddr(*end - 1));
+}
+
+void sys_mlock(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  uint8_t *start, *end;
+  f->eax = user_range(p, &start, &end) && page_mlock(start, end) ? 0 : -1;
+}
+
+void sys_munlock(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  uint8_t *start, *end;
+  f->eax = -1;
+  if (user_range(p, &start, &end)) {
+    page_munlock(start, end);
+    f->eax = 0;
+  }
+}
+
+void sys_futex_wait(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  f->eax = futex_wait((int *)*(p + 1), *(p + 2));
+}
+
+void sys_futex_wake(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  f->eax = futex_wake((int *)*(p + 1), *(p + 2));
+}
+
+void sys_thread_create(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 3);
+  f->eax = process_thread_create((void (*)(void))*(p + 1),
+                                 (void *)*(p + 2), (void *)*(p + 3));
+}
+
+void sys_thread_exit(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+  process_thread_exit(*(p + 1));
+}
+
+void sys_thread_join(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 1);
+  f->eax = process_thread_join(*(p + 1));
+}
+
+// read the clock named by the first argument into the struct
+// timespec the second points to
+void sys_clock_gettime(struct intr_frame *f) {
+  int *p = f->esp;
+  check_func_args((void *)(p + 1), 2);
+  struct timespec ts;
+  int64_t ns;
+
+  f->eax = -1;
+  if (*(p + 1) != CLOCK_MONOTONIC)
+    return;
+  ns = timer_nanos();
+  ts.tv_sec = ns / NS_PER_SEC;
+  ts.tv_nsec = ns % NS_PER_SEC;
+  if (copy_out((struct timespec *)*(p + 2), &ts, sizeof ts))
+    f->eax = 0;
+}
+#endif
@@ -5,7 +5,7 @@
 #include "list.h"
 
 typedef void (*syscall_function) (struct intr_frame *);
-#define SYSCALL_NUMBER 25
+#define SYSCALL_NUMBER 32
 
 void syscall_init (void);
 
@@ -29,6 +29,11 @@ void sys_seek(struct intr_frame *);
 void sys_tell(struct intr_frame *);
 void sys_close(struct intr_frame *);
 
+/* Project 3. */
+void sys_mmap(struct intr_frame *);
+void sys_munmap(struct intr_frame *);
+void mmap_exit(void);
+
 /* Project 4 only. */
 void sys_CHDIR(struct intr_frame *);  /* Change the current directory. */
 void sys_MKDIR(struct intr_frame *);  /* Create a directory. */
@@ -38,6 +43,19 @@ void sys_INUMBER(struct intr_frame *); /* Returns the inode number for a fd. */
 
 void sys_CACHE_FLUSH(struct intr_frame *); /* */
 
+/* Extensions. */
+void sys_fork(struct intr_frame *);           /* Duplicate the calling process. */
+void sys_vmstat(struct intr_frame *);         /* Get virtual memory statistics. */
+void sys_madvise(struct intr_frame *);        /* Give a hint about memory use. */
+void sys_mlock(struct intr_frame *);          /* Lock pages in memory. */
+void sys_munlock(struct intr_frame *);        /* Unlock pages locked by mlock. */
+void sys_futex_wait(struct intr_frame *);     /* Sleep while a word has a value. */
+void sys_futex_wake(struct intr_frame *);     /* Wake threads sleeping on a word. */
+void sys_thread_create(struct intr_frame *);  /* Start a thread in this process. */
+void sys_thread_exit(struct intr_frame *);    /* End the calling thread. */
+void sys_thread_join(struct intr_frame *);    /* Wait for a thread to end. */
+void sys_clock_gettime(struct intr_frame *);  /* Read a high-resolution clock. */
+
 struct file_node * find_file(struct list *, int);
 void exit(int);
 /* A file descriptor, for binding a file handle to a file. */
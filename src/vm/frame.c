@@ -1,13 +1,16 @@
 #include "vm/frame.h"
 #include <stdio.h>
 #include "vm/page.h"
+#include "vm/swap.h"
 #include "devices/timer.h"
+#include "filesys/file.h"
 #include "threads/init.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/thread.h"
+#include "userprog/pagedir.h"
 
 static struct frame *frames;
 static uint32_t count;
@@ -15,6 +18,24 @@ static struct lock scan_lock;
 static uint32_t handle;
 static struct list frame_list;
 
+/* Frames holding read-only executable pages, keyed by
+   (inode, offset, bytes read), so that processes running the
+   same binary map the same frame.  The byte count keeps pages
+   that read the same file page with different zero-filled tails
+   apart.  Lock ordering: share_lock may be taken
+   while holding a frame lock, but a frame lock is only ever
+   tried (never waited for) while holding share_lock. */
+static struct hash share_table;
+static struct lock share_lock;
+
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static bool frame_pinned (struct frame *);
+static bool frame_recently_used (struct frame *);
+static struct frame *share_join (struct spt_elem *, bool *busy);
+static void frame_share_evict (struct frame *);
+static bool frame_cow_evict (struct frame *);
+
 /* Initialize the frame manager. */
 void
 frame_init (void) 
@@ -22,6 +43,10 @@ frame_init (void)
   // tmp;
 
   lock_init (&scan_lock);
+  lock_init (&share_lock);
+  lock_register (&scan_lock, "frame scan");
+  lock_register (&share_lock, "frame share");
+  hash_init (&share_table, share_hash, share_less, NULL);
   frames = malloc (sizeof *frames * init_ram_pages);
   int test = frames == NULL;
   switch(test*2){
@@ -33,8 +58,13 @@ frame_init (void)
   for (void *tmp; (tmp= palloc_get_page(PAL_USER)) != NULL;) {
       struct frame *f = &frames[count++];
       lock_init(&f->lock);
+      lock_register(&f->lock, "frame");
       f->base = tmp;
       f->page = NULL;
+      f->inode = NULL;
+      f->ref_cnt = 0;
+      f->futex_waiters = 0;
+      list_init(&f->sharers);
   }
 }
 
@@ -43,12 +73,12 @@ frame_init (void)
 static struct frame *
 try_frame_alloc_and_lock (struct spt_elem *page) 
 {
-  size_t i = 0;
+  size_t i;
 
   lock_acquire (&scan_lock);
 
   /* Find a free frame. */
-  while (i < count) {
+  for (i = 0; i < count; i++) {
       struct frame *f = &frames[i];
       if (!lock_try_acquire(&f->lock))
           continue;
@@ -58,11 +88,11 @@ try_frame_alloc_and_lock (struct spt_elem *page)
           return f;
       }
       lock_release(&f->lock);
-      i++;
   }
-i = 0;
-/* No free frame.  Find a frame to evict. */
-while (i < count * 2) {
+
+/* No free frame.  Find a frame to evict.  Frames of mlock()ed
+   pages and frames with futex waiters are never chosen. */
+for (i = 0; i < count * 2; i++) {
     /* Get a frame. */
     struct frame *f = &frames[handle];
     if (++handle >= count)
@@ -77,15 +107,25 @@ while (i < count * 2) {
         return f;
     }
 
-    if (page_get_recently(f->page)) {
+    if (frame_pinned(f) || frame_recently_used(f)) {
         lock_release(&f->lock);
         continue;
     }
 
     lock_release(&scan_lock);
 
-    /* Evict this frame. */
-    if (!page_out(f->page)) {
+    /* Evict this frame.  Shared frames are clean and read-only,
+       so it is enough to unmap them from every sharer. */
+    if (f->inode != NULL)
+        frame_share_evict(f);
+    else if (f->ref_cnt > 0) {
+        if (!frame_cow_evict(f)) {
+            lock_release(&f->lock);
+            return NULL;
+        }
+    } else if (page_out(f->page, NULL))
+        page_evicted(f->page);
+    else {
         lock_release(&f->lock);
         return NULL;
     }
@@ -93,7 +133,6 @@ while (i < count * 2) {
         f->page = page;
         return f;
     }
-    i++;
 }
 
   lock_release (&scan_lock);
@@ -134,13 +173,10 @@ frame_lock (struct spt_elem *p)
   while (f != NULL) 
     {
       lock_acquire (&f->lock);
-      if (f == p->frame) {
-          thread_set_nice(0);
-      } else {
-          (&f->lock)->holder = NULL;
-          sema_up(&(&f->lock)->semaphore);
-      }
-      break;
+      if (f == p->frame)
+        break;
+      lock_release (&f->lock);
+      f = p->frame;
     }
 }
 
@@ -151,8 +187,7 @@ void
 frame_free (struct frame *f)
 {
   f->page = NULL;
-    (&f->lock)->holder = NULL;
-  sema_up(&(&f->lock)->semaphore);
+  lock_release (&f->lock);
 }
 
 /* Unlocks frame F, allowing it to be evicted.
@@ -160,8 +195,256 @@ frame_free (struct frame *f)
 void
 frame_unlock (struct frame *f) 
 {
-  (&f->lock)->holder = NULL;
-  sema_up(&(&f->lock)->semaphore);
+  lock_release (&f->lock);
+}
+
+/* Returns a frame for P, which must be a read-only page backed
+   by a file, locked for use by the current process.  If another
+   process already has the same page of the same inode in memory,
+   that frame is shared and *LOADED is set to true.  Otherwise a
+   new frame is allocated and published for others to share, and
+   *LOADED is set to false: the caller must then read the page in
+   before unlocking the frame.  Returns a null pointer if no frame
+   could be obtained. */
+struct frame *
+frame_share_alloc (struct spt_elem *p, bool *loaded)
+{
+  struct inode *inode = file_get_inode (p->fileptr);
+  struct frame *f;
+  bool busy;
+
+  for (;;)
+    {
+      f = share_join (p, &busy);
+      if (f != NULL)
+        {
+          *loaded = true;
+          return f;
+        }
+      if (!busy)
+        break;
+
+      /* The frame is being read in or evicted.  Try again. */
+      thread_yield ();
+    }
+
+  f = frame_alloc (p);
+  if (f == NULL)
+    return NULL;
+  f->inode = inode;
+  f->ofs = p->ofs;
+  f->bytes = p->bytes;
+  f->ref_cnt = 1;
+  list_push_back (&f->sharers, &p->share_elem);
+
+  /* Someone may have published the same page meanwhile; if so,
+     keep ours private. */
+  lock_acquire (&share_lock);
+  if (hash_insert (&share_table, &f->share_elem) != NULL)
+    {
+      list_remove (&p->share_elem);
+      f->ref_cnt = 0;
+      f->inode = NULL;
+    }
+  lock_release (&share_lock);
+
+  *loaded = false;
+  return f;
+}
+
+/* Like frame_share_alloc(), but never allocates or waits: returns
+   P's page locked if some process already has it in memory and
+   the frame is not busy, otherwise a null pointer. */
+struct frame *
+frame_share_try (struct spt_elem *p)
+{
+  bool busy;
+  return share_join (p, &busy);
+}
+
+/* Looks P's page up in the shared page table.  If it is there
+   and its frame can be locked without waiting, adds P as a
+   sharer and returns the locked frame.  Otherwise returns a null
+   pointer, setting *BUSY to true if the page was found but its
+   frame is locked by someone else. */
+static struct frame *
+share_join (struct spt_elem *p, bool *busy)
+{
+  struct frame key;
+  struct hash_elem *e;
+  struct frame *f = NULL;
+
+  key.inode = file_get_inode (p->fileptr);
+  key.ofs = p->ofs;
+  key.bytes = p->bytes;
+  *busy = false;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&share_table, &key.share_elem);
+  if (e != NULL)
+    {
+      f = hash_entry (e, struct frame, share_elem);
+      if (lock_try_acquire (&f->lock))
+        {
+          list_push_back (&f->sharers, &p->share_elem);
+          f->ref_cnt++;
+        }
+      else
+        {
+          f = NULL;
+          *busy = true;
+        }
+    }
+  lock_release (&share_lock);
+  return f;
+}
+
+/* Drops page P's reference to its shared frame, which P must
+   have locked.  The frame is released for reuse once its last
+   sharer is gone, otherwise it is just unlocked. */
+void
+frame_share_release (struct spt_elem *p)
+{
+  struct frame *f = p->frame;
+
+  ASSERT (lock_held_by_current_thread (&f->lock));
+
+  list_remove (&p->share_elem);
+  p->frame = NULL;
+  if (--f->ref_cnt > 0)
+    {
+      if (f->page == p)
+        f->page = list_entry (list_front (&f->sharers),
+                              struct spt_elem, share_elem);
+      frame_unlock (f);
+      return;
+    }
+
+  if (f->inode != NULL)
+    {
+      lock_acquire (&share_lock);
+      hash_delete (&share_table, &f->share_elem);
+      lock_release (&share_lock);
+      f->inode = NULL;
+    }
+  frame_free (f);
+}
+
+/* Unmaps locked shared frame F from every page that maps it and
+   withdraws it from the shared page table.  The pages will read
+   their data back from the file on their next fault. */
+static void
+frame_share_evict (struct frame *f)
+{
+  lock_acquire (&share_lock);
+  hash_delete (&share_table, &f->share_elem);
+  lock_release (&share_lock);
+
+  while (!list_empty (&f->sharers))
+    {
+      struct spt_elem *p = list_entry (list_pop_front (&f->sharers),
+                                       struct spt_elem, share_elem);
+      pagedir_clear_page (p->thread->pagedir, p->addr);
+      p->frame = NULL;
+      page_evicted (p);
+    }
+  f->inode = NULL;
+  f->ref_cnt = 0;
+}
+
+/* Evicts locked frame F, which is shared copy-on-write by the
+   pages on its sharers list.  Each page that cannot simply be
+   re-read from its file gets its own copy in swap.  Returns true
+   if successful, false if swap is full. */
+static bool
+frame_cow_evict (struct frame *f)
+{
+  struct list_elem *e;
+  bool dirty = false;
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    {
+      struct spt_elem *p = list_entry (e, struct spt_elem, share_elem);
+      pagedir_clear_page (p->thread->pagedir, p->addr);
+      if (pagedir_is_dirty (p->thread->pagedir, p->addr))
+        dirty = true;
+    }
+
+  while (!list_empty (&f->sharers))
+    {
+      struct spt_elem *p = list_entry (list_front (&f->sharers),
+                                       struct spt_elem, share_elem);
+      if ((dirty || p->fileptr == NULL) && !swap_out (p))
+        return false;
+      list_remove (&p->share_elem);
+      p->cow = false;
+      p->frame = NULL;
+      page_evicted (p);
+      f->ref_cnt--;
+    }
+  return true;
+}
+
+/* Returns true if any page mapping frame F, which must be locked,
+   is locked in memory by mlock(), or if a thread is waiting on a
+   futex in F. */
+static bool
+frame_pinned (struct frame *f)
+{
+  struct list_elem *e;
+
+  if (f->futex_waiters > 0)
+    return true;
+  if (f->ref_cnt == 0)
+    return f->page->pinned;
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    if (list_entry (e, struct spt_elem, share_elem)->pinned)
+      return true;
+  return false;
+}
+
+/* Returns true if any page mapping frame F, which must be locked,
+   has been accessed recently, clearing the accessed bits. */
+static bool
+frame_recently_used (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  if (f->ref_cnt == 0)
+    return page_get_recently (f->page);
+
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers);
+       e = list_next (e))
+    if (page_get_recently (list_entry (e, struct spt_elem, share_elem)))
+      accessed = true;
+  return accessed;
+}
+
+/* Returns a hash value for the shared frame that E refers to. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, share_elem);
+  return (hash_bytes (&f->inode, sizeof f->inode) ^ hash_int (f->ofs)
+          ^ hash_int (f->bytes));
+}
+
+/* Returns true if shared frame A precedes shared frame B. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->bytes < b->bytes;
 }
 
 static struct frame *get_frame_by_paddr(void *paddr) {
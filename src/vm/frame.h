@@ -1,6 +1,8 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
+#include <hash.h>
+#include "filesys/off_t.h"
 #include "threads/synch.h"
 
 /* A physical frame. */
@@ -9,6 +11,21 @@ struct frame {
     struct lock lock; /* Prevent simultaneous access. */
     void *base; /* Kernel virtual base address. */
     struct list_elem frame_elem;
+
+    /* Read-only file pages shared between processes.
+       Protected by lock. */
+    struct inode *inode; /* Backing inode if shared, else null. */
+    off_t ofs; /* Offset of the page within INODE. */
+    off_t bytes; /* Bytes read from INODE, the rest zeroed. */
+    int ref_cnt; /* Number of pages mapping this frame. */
+    struct list sharers; /* Reverse map: spt_elem `share_elem's. */
+    struct hash_elem share_elem; /* Element in the shared page table. */
+
+    /* Threads sleeping in futex_wait() on a word in this frame,
+       which keep it from being evicted.  Incremented with LOCK
+       and the futex lock held, decremented with the futex lock
+       held. */
+    int futex_waiters;
 };
 
 void frame_init (void);
@@ -18,5 +35,8 @@ void frame_lock (struct spt_elem *);
 void frame_free (struct frame *);
 void frame_unlock (struct frame *);
 struct frame *frame_try_alloc (struct spt_elem *page);
+struct frame *frame_share_alloc (struct spt_elem *, bool *loaded);
+struct frame *frame_share_try (struct spt_elem *);
+void frame_share_release (struct spt_elem *);
 
 #endif /* vm/frame.h */
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include "vm/futex.h"
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Number of wait queues.  Waiters on different words may share a
+   queue. */
+#define FUTEX_BUCKETS 64
+
+/* A thread sleeping in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in a bucket. */
+    const int *key;             /* Kernel address of the word. */
+    struct frame *frame;        /* Frame holding the word. */
+    struct thread *thread;      /* Sleeping thread. */
+    struct semaphore sema;      /* Upped by futex_wake(). */
+  };
+
+/* Wait queues, and every frame's futex_waiters, are protected by
+   futex_lock.  A frame lock may be held while acquiring it, but
+   not the other way around. */
+static struct list buckets[FUTEX_BUCKETS];
+static struct lock futex_lock;
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void)
+{
+  int i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    list_init (&buckets[i]);
+  lock_init (&futex_lock);
+  lock_register (&futex_lock, "futex");
+}
+
+/* Returns the wait queue for the word at kernel address KEY. */
+static struct list *
+bucket (const int *key)
+{
+  return &buckets[((uintptr_t) key / sizeof *key) % FUTEX_BUCKETS];
+}
+
+/* Brings the page holding UADDR into a private, writable frame
+   and locks it, as page_lock() does.  Returns the frame, or a
+   null pointer if UADDR is not an aligned, writable user
+   address. */
+static struct frame *
+futex_lock_page (int *uaddr)
+{
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0 || !is_user_vaddr (uaddr))
+    return NULL;
+
+  /* Locking for writing breaks copy-on-write sharing first, so
+     the frame, and with it the key, does not change on the next
+     write. */
+  if (!page_lock (uaddr, true))
+    return NULL;
+  return page_find (uaddr)->frame;
+}
+
+/* Sleeps until woken by futex_wake() on UADDR, if the int at UADDR
+   equals EXPECTED.  The comparison and going to sleep are atomic
+   with respect to futex_wake().  Returns 0 after being woken, -1
+   if the value differed, UADDR is invalid, or the process is
+   exiting. */
+int
+futex_wait (int *uaddr, int expected)
+{
+  struct futex_waiter w;
+  struct frame *f;
+
+  f = futex_lock_page (uaddr);
+  if (f == NULL)
+    return -1;
+
+  w.key = (const int *) ((uint8_t *) f->base + pg_ofs (uaddr));
+  lock_acquire (&futex_lock);
+  if (*w.key != expected || thread_process ()->exiting)
+    {
+      lock_release (&futex_lock);
+      page_unlock (uaddr);
+      return -1;
+    }
+  w.frame = f;
+  w.thread = thread_current ();
+  sema_init (&w.sema, 0);
+  list_push_back (bucket (w.key), &w.elem);
+  f->futex_waiters++;
+  lock_release (&futex_lock);
+  page_unlock (uaddr);
+
+  sema_down (&w.sema);
+  return thread_process ()->exiting ? -1 : 0;
+}
+
+/* Wakes up to COUNT threads waiting on UADDR, in the order they
+   went to sleep.  Returns the number woken, or -1 if UADDR is
+   invalid. */
+int
+futex_wake (int *uaddr, int count)
+{
+  const int *key;
+  struct list *b;
+  struct list_elem *e;
+  struct frame *f;
+  int woken = 0;
+
+  f = futex_lock_page (uaddr);
+  if (f == NULL)
+    return -1;
+
+  key = (const int *) ((uint8_t *) f->base + pg_ofs (uaddr));
+  b = bucket (key);
+  lock_acquire (&futex_lock);
+  for (e = list_begin (b); e != list_end (b) && woken < count; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+      e = list_next (e);
+      if (w->key == key)
+        {
+          list_remove (&w->elem);
+          w->frame->futex_waiters--;
+          sema_up (&w->sema);
+          woken++;
+        }
+    }
+  lock_release (&futex_lock);
+  page_unlock (uaddr);
+  return woken;
+}
+
+/* Wakes every thread of PROCESS, given by its main thread, that
+   is waiting on a futex, so that it can exit.  PROCESS's
+   `exiting' must already be true. */
+void
+futex_exit (struct thread *process)
+{
+  int i;
+
+  ASSERT (process->exiting);
+
+  lock_acquire (&futex_lock);
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&buckets[i]); e != list_end (&buckets[i]); )
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+
+          e = list_next (e);
+          if (w->thread->process == process)
+            {
+              list_remove (&w->elem);
+              w->frame->futex_waiters--;
+              sema_up (&w->sema);
+            }
+        }
+    }
+  lock_release (&futex_lock);
+}
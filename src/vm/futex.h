@@ -0,0 +1,20 @@
+#ifndef VM_FUTEX_H
+#define VM_FUTEX_H
+
+struct thread;
+
+/* Fast user-space mutexes.
+
+   A futex is an aligned int in user memory.  User code changes
+   it with atomic instructions and enters the kernel only to
+   sleep until it changes or to wake sleepers.  Waiters are keyed
+   by the frame and offset holding the word, so threads mapping
+   the same frame share a futex wherever it appears in their
+   address spaces. */
+
+void futex_init (void);
+int futex_wait (int *uaddr, int expected);
+int futex_wake (int *uaddr, int count);
+void futex_exit (struct thread *process);
+
+#endif /* vm/futex.h */
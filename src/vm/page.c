@@ -1,55 +1,134 @@
 #include <stdio.h>
 #include <string.h>
+#include <bitmap.h>
+#include <madvise.h>
+#include <stdio.h>
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/region.h"
 #include "vm/swap.h"
 #include "filesys/file.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "threads/vaddr.h"
 
+/* Number of neighbouring pages on each side of a faulting page
+   that page_in() maps if they are already resident.  Set with
+   the "-fa" kernel command-line option; 0 disables fault-around. */
+int page_fault_around_pages = 4;
+
+/* Number of pages read ahead of a fault in a region advised
+   MADV_SEQUENTIAL. */
+#define PAGE_READ_AHEAD 8
+
+/* Most pages a process may lock in memory with mlock().  Set
+   with the "-ml" kernel command-line option. */
+int page_mlock_limit = 64;
+
+/* Print each process's virtual memory statistics when it exits.
+   Set with the "-vmstat" kernel command-line option. */
+bool page_print_vmstat;
+
+/* A page of zeros, mapped read-only in place of anonymous pages
+   that have been read but never written. */
+static void *zero_page;
+
+static bool page_is_zero (const struct spt_elem *);
+static void page_unmap (struct spt_elem *, struct pagedir_batch *);
+static void page_drop (struct spt_elem *, struct pagedir_batch *);
+static void page_count_fault (struct spt_elem *, bool major);
+static bool page_is_shareable (const struct spt_elem *);
+static void page_fault_around (struct spt_elem *);
+static void page_map_resident (struct spt_elem *);
+static struct spt_elem *page_from_region (const void *);
+static void page_read_ahead (struct spt_elem *, struct region *);
+
+/* Allocates the shared zero page. */
+void
+page_init (void)
+{
+  zero_page = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+}
+
 /* Adds a mapping for user virtual address VADDR to the page hash
    table.  Fails if VADDR is already mapped or if memory
    allocation fails. */
 struct spt_elem *page_allocate (void *vaddr, int read_only){
-    struct thread *t = thread_current();
+    struct thread *t = thread_process();
     struct spt_elem *p = malloc(sizeof *p);
+    bool locked;
     if (p == NULL) {
         return p;
     } else {
         p->addr = pg_round_down(vaddr);
         p->read_only = read_only;
+        p->cow = false;
+        p->pinned = false;
         p->writable = !read_only;
         p->frame = NULL;
         p->sector = (block_sector_t)-1;
+        p->zslot = BITMAP_ERROR;
         p->fileptr = NULL;
         p->ofs = 0;
         p->bytes = 0;
-        p->thread = thread_current();
+        p->thread = t;
 
-        return (hash_insert(t->pages, &p->hash_elem)!= NULL) ?  free(p),(void *)0:p;        
+        locked = page_table_acquire();
+        if (hash_insert(t->pages, &p->hash_elem) != NULL) {
+            free(p);
+            p = NULL;
+        }
+        page_table_release(locked);
+        return p;
     }
 };
 
-/* Find the page containing 
-   address the given page. */
+/* Acquires the current process's vm_lock, which keeps its threads
+   from changing its page and region tables at the same time,
+   unless the running thread holds it already.  Returns true if it
+   was acquired here.  The result must be passed to
+   page_table_release(). */
+bool
+page_table_acquire (void)
+{
+  struct lock *l = &thread_process ()->vm_lock;
+
+  if (lock_held_by_current_thread (l))
+    return false;
+  lock_acquire (l);
+  return true;
+}
+
+/* Releases the vm_lock taken by page_table_acquire(), if ACQUIRED. */
+void
+page_table_release (bool acquired)
+{
+  if (acquired)
+    lock_release (&thread_process ()->vm_lock);
+}
+
+/* Returns the current process's page containing UPAGE, or a
+   null pointer if it has none.  Unlike page_for_addr(), never
+   creates a page. */
 struct spt_elem *
-page_find (void *upage){
-    struct thread *t = thread_current();
-    struct spt_elem *spte;
-    struct list_elem *e;
-    e=list_begin(&t->stack_pointer);
-    while(e!=list_end(&t->stack_pointer)){
-        spte=(struct spt_elem *) list_entry (e, struct spt_elem, slot_elem);
-        if(upage==spte->upage){
-            return e;
-            e=list_next(e);
-        }
-        e=list_next(e);
-    }
-    return 0;
-};
+page_find (const void *upage)
+{
+  struct thread *t = thread_process ();
+  struct spt_elem p;
+  struct hash_elem *e;
+  bool locked;
+
+  if (t->pages == NULL)
+    return NULL;
+  p.addr = pg_round_down (upage);
+  locked = page_table_acquire ();
+  e = hash_find (t->pages, &p.hash_elem);
+  page_table_release (locked);
+  return e != NULL ? hash_entry (e, struct spt_elem, hash_elem) : NULL;
+}
 
 /* Returns the page containing the given virtual ADDRESS,
    or a null pointer if no such page exists. */
@@ -95,112 +174,116 @@ page_get_addr (const void *address){
 };
 
 /* Evicts the page containing address VADDR
-   and removes it from the page table. */
-void page_deallocate (void *vaddr){
-    struct spt_elem *p = page_get_addr(vaddr);
-    struct frame *f = p->frame;
-    struct thread *t = thread_current();
-
-    frame_lock(p);
-
-    int s = p->frame;
-    int tb = p->fileptr;
-    int b = p->writable;
-    int st = s * 4 + tb * 2 + b;
-
-    switch (st) {
-    case 0:
-        frame_free(f);
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 1:
-        frame_free(f);
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 2:
-        page_out(p);
-        frame_free(f);
+   and removes it from the page table.  A memory-mapped file page
+   is written back to its file first if it is dirty.  The page's
+   TLB entry is invalidated at once if BATCH is null, otherwise
+   when BATCH ends. */
+void
+page_deallocate (void *vaddr, struct pagedir_batch *batch)
+{
+  struct thread *t = thread_process ();
+  bool locked;
+  struct spt_elem *p = page_find (vaddr);
 
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 3:
-        frame_free(f);
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 4:
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 5:
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 6:
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    case 7:
-        hash_delete(t->pages, &p->hash_elem);
-        free(p);
-        break;
-    }
+  ASSERT (p != NULL);
+  if (p->pinned)
+    t->vmstat.locked--;
+  page_drop (p, batch);
+  locked = page_table_acquire ();
+  hash_delete (t->pages, &p->hash_elem);
+  page_table_release (locked);
+  free (p);
+}
 
-    if (p->frame) {
-        if (p->fileptr && p->writable)
-            frame_free(f);
-        else {
-            page_out(p);
-            frame_free(f);
+/* Unmaps page P and gives up its frame, writing a dirty mapped
+   file page back to its file first, or its swap slot.  The TLB
+   entry is invalidated as by page_deallocate(). */
+static void
+page_drop (struct spt_elem *p, struct pagedir_batch *batch)
+{
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      struct frame *f = p->frame;
+      if (f->ref_cnt > 0)
+        {
+          /* Shared text or copy-on-write: just leave the frame. */
+          page_unmap (p, batch);
+          frame_share_release (p);
+        }
+      else
+        {
+          if (p->fileptr != NULL && !p->writable)
+            page_out (p, batch);
+          else
+            page_unmap (p, batch);
+          frame_free (f);
         }
+      page_rss_add (p, -1);
     }
-    hash_delete(t->pages, &p->hash_elem);
-    free(p);
-};
-
+  else
+    {
+      page_unmap (p, batch);
+      swap_discard (p);
+    }
+}
 
 /* Returns the page containing the given virtual ADDRESS,
    or a null pointer if no such page exists.
-   Allocates stack pages as necessary. */
-static struct page *page_for_addr(const void *address) {
+   Allocates stack pages as necessary.  Holds the page table
+   lock throughout, so that threads of a process faulting on the
+   same new page get the same one. */
+static struct spt_elem *page_for_addr(const void *address) {
+    struct spt_elem *p = NULL;
+    bool locked;
+
     if (address < PHYS_BASE) {
-        struct spt_elem p;
-        struct hash_elem *e;
+        struct region *r;
+
+        locked = page_table_acquire();
 
         /* Find existing page. */
-        p.addr = (void *)pg_round_down(address);
-        e = hash_find(thread_current()->pages, &p.hash_elem);
-        if (e != NULL)
-            return hash_entry(e, struct spt_elem, hash_elem);
+        p = page_find(address);
 
-        if (address >= PHYS_BASE - 1024 * 1024) {
+        /* First touch of a segment or mapping. */
+        if (p == NULL && (r = region_find(address)) != NULL)
+            p = region_get_page(r, address);
+        else if (p == NULL && address >= PHYS_BASE - 1024 * 1024) {
             if (address >= thread_current()->stack_pointer - 32) {
-                return page_allocate((void *)address, false);
+                p = page_allocate((void *)address, false);
             }
         }
+
+        page_table_release(locked);
     }
-    return NULL;
+    return p;
 }
 
-/* Faults in the page containing FAULT_ADDR.
+/* Faults in the page containing FAULT_ADDR, for writing if
+   WRITE is true.  A read of an anonymous page that holds nothing
+   yet maps the shared zero page instead of allocating a frame.
    Returns true if successful, false on failure. */
 int
-page_in (void *fault_addr) 
+page_in (void *fault_addr, bool write)
 {
   struct spt_elem *p;
   int success;
 
   /* Can't handle page faults without a hash table. */
-  if (thread_current ()->pages == NULL) 
+  if (thread_process ()->pages == NULL) 
     return false;
 
   p = page_for_addr (fault_addr);
   if (p == NULL) 
     return false; 
 
+  if (!write && page_is_zero (p))
+    {
+      page_count_fault (p, false);
+      return pagedir_set_page (thread_current ()->pagedir, p->addr,
+                               zero_page, false);
+    }
+
   frame_lock (p);
   if (p->frame == NULL)
     {
@@ -211,46 +294,361 @@ page_in (void *fault_addr)
     
   /* Install frame into page table. */
   success = pagedir_set_page (thread_current ()->pagedir, p->addr,
-                              p->frame->base, !p->read_only);
+                              p->frame->base, !p->read_only && !p->cow);
 
   /* Release frame. */
   frame_unlock (p->frame);
 
+  if (success)
+    page_fault_around (p);
   return success;
 }
 
+/* Maps the pages next to P, up to page_fault_around pages on
+   each side, that are already in memory and belong to the same
+   region as P (same file at contiguous offsets, or both
+   anonymous, with the same protection), so that walking through
+   the region does not take one fault per page.  Nothing is read
+   from disk and no frame is waited for.  Regions advised
+   MADV_RANDOM get no fault-around, and those advised
+   MADV_SEQUENTIAL read ahead instead. */
+static void
+page_fault_around (struct spt_elem *p)
+{
+  struct region *r = region_find (p->addr);
+  int advice = r != NULL ? r->advice : MADV_NORMAL;
+  int dir;
+
+  if (advice == MADV_RANDOM)
+    return;
+  if (advice == MADV_SEQUENTIAL)
+    {
+      page_read_ahead (p, r);
+      return;
+    }
+
+  for (dir = -1; dir <= 1; dir += 2)
+    {
+      int i;
+      for (i = 1; i <= page_fault_around_pages; i++)
+        {
+          uint8_t *addr = (uint8_t *) p->addr + dir * i * PGSIZE;
+          struct spt_elem *q;
+
+          if (addr < (uint8_t *) PGSIZE || !is_user_vaddr (addr))
+            break;
+          q = page_find (addr);
+          if (q == NULL)
+            q = page_from_region (addr);
+          if (q == NULL || q->fileptr != p->fileptr
+              || q->read_only != p->read_only
+              || (q->fileptr != NULL
+                  && q->ofs != p->ofs + dir * i * PGSIZE))
+            break;
+          page_map_resident (q);
+        }
+    }
+}
+
+/* Brings in the PAGE_READ_AHEAD pages of region R that follow
+   page P, reading them from their file or swap if necessary. */
+static void
+page_read_ahead (struct spt_elem *p, struct region *r)
+{
+  uint8_t *addr = (uint8_t *) p->addr + PGSIZE;
+  int i;
+
+  for (i = 0; i < PAGE_READ_AHEAD && addr < r->end; i++, addr += PGSIZE)
+    page_prefetch (addr);
+}
+
+/* Brings the page containing ADDR into memory and maps it, if it
+   belongs to the current process and has data to read.  Pages
+   that would just be zero-filled are left alone. */
+void
+page_prefetch (const void *addr)
+{
+  struct spt_elem *p = page_find (addr);
+
+  if (p == NULL)
+    {
+      struct region *r = region_find (addr);
+      if (r == NULL || (uint8_t *) pg_round_down (addr) - r->start >= r->length)
+        return;
+      p = region_get_page (r, addr);
+      if (p == NULL)
+        return;
+    }
+  if (page_is_zero (p))
+    return;
+
+  frame_lock (p);
+  if (p->frame != NULL)
+    {
+      frame_unlock (p->frame);
+      page_map_resident (p);
+    }
+  else if (page_get_in (p))
+    {
+      pagedir_set_page (thread_current ()->pagedir, p->addr, p->frame->base,
+                        !p->read_only && !p->cow);
+      frame_unlock (p->frame);
+    }
+}
+
+/* Applies madvise() hint ADVICE to the current process's pages
+   from START up to END, both page-aligned.  MADV_NORMAL,
+   MADV_SEQUENTIAL and MADV_RANDOM set the access pattern of every
+   region the range touches, as a whole.  MADV_WILLNEED brings the
+   pages in now.  MADV_DONTNEED drops them: mapped file pages are
+   written back first, other pages of a region are read back from
+   its file or zero-filled on their next access, and stack pages
+   are zero-filled.  Pages locked by mlock() are left alone.
+   Returns true if successful, false if ADVICE is invalid. */
+bool
+page_madvise (uint8_t *start, uint8_t *end, int advice)
+{
+  struct pagedir_batch batch;
+  uint8_t *addr;
+
+  switch (advice)
+    {
+    case MADV_NORMAL:
+    case MADV_SEQUENTIAL:
+    case MADV_RANDOM:
+      for (addr = start; addr < end; )
+        {
+          struct region *r = region_find (addr);
+          if (r != NULL)
+            {
+              r->advice = advice;
+              addr = r->end;
+            }
+          else
+            addr += PGSIZE;
+        }
+      return true;
+
+    case MADV_WILLNEED:
+      for (addr = start; addr < end; addr += PGSIZE)
+        page_prefetch (addr);
+      return true;
+
+    case MADV_DONTNEED:
+      pagedir_batch_begin (&batch, thread_current ()->pagedir);
+      for (addr = start; addr < end; addr += PGSIZE)
+        {
+          struct spt_elem *p = page_find (addr);
+
+          if (p == NULL || p->pinned)
+            continue;
+          if (region_find (addr) != NULL)
+            page_deallocate (addr, &batch);
+          else
+            {
+              /* A stack page below the stack pointer would not be
+                 created again, so keep it as a zero page. */
+              page_drop (p, &batch);
+              p->frame = NULL;
+              p->cow = false;
+              p->writable = !p->read_only;
+              p->fileptr = NULL;
+              p->ofs = 0;
+              p->bytes = 0;
+            }
+        }
+      pagedir_batch_end (&batch);
+      return true;
+
+    default:
+      return false;
+    }
+}
+
+/* Locks the current process's pages from START up to END, both
+   page-aligned, into memory, bringing them in first if needed.
+   Locked pages are never evicted until unlocked with
+   page_munlock().  Fails if the process would then have more than
+   page_mlock_limit pages locked or if a page in the range does not
+   exist, in which case no page is newly locked.  Returns true if
+   successful, false on failure. */
+bool
+page_mlock (uint8_t *start, uint8_t *end)
+{
+  struct thread *t = thread_process ();
+  struct bitmap *newly;
+  int need = 0;
+  uint8_t *addr;
+  size_t i;
+
+  for (addr = start; addr < end; addr += PGSIZE)
+    {
+      struct spt_elem *p = page_find (addr);
+      if (p == NULL || !p->pinned)
+        need++;
+    }
+  if (t->vmstat.locked + need > page_mlock_limit)
+    return false;
+
+  /* Pages this call locks, as opposed to ones an earlier mlock()
+     already had, so that failure unlocks only the former. */
+  newly = bitmap_create ((end - start) / PGSIZE);
+  if (newly == NULL)
+    return false;
+
+  for (addr = start; addr < end; addr += PGSIZE)
+    {
+      struct spt_elem *p = page_for_addr (addr);
+
+      if (p == NULL)
+        goto fail;
+      frame_lock (p);
+      if (p->frame == NULL)
+        {
+          if (!page_get_in (p))
+            goto fail;
+          pagedir_set_page (t->pagedir, p->addr, p->frame->base,
+                            !p->read_only && !p->cow);
+        }
+      if (!p->pinned)
+        {
+          p->pinned = true;
+          t->vmstat.locked++;
+          bitmap_mark (newly, (addr - start) / PGSIZE);
+        }
+      frame_unlock (p->frame);
+    }
+  bitmap_destroy (newly);
+  return true;
+
+ fail:
+  for (i = 0; i < (size_t) (addr - start) / PGSIZE; i++)
+    if (bitmap_test (newly, i))
+      page_munlock (start + i * PGSIZE, start + (i + 1) * PGSIZE);
+  bitmap_destroy (newly);
+  return false;
+}
+
+/* Unlocks the current process's pages from START up to END, both
+   page-aligned, so that they may be evicted again. */
+void
+page_munlock (uint8_t *start, uint8_t *end)
+{
+  struct thread *t = thread_process ();
+  uint8_t *addr;
+
+  for (addr = start; addr < end; addr += PGSIZE)
+    {
+      struct spt_elem *p = page_find (addr);
+      if (p == NULL || !p->pinned)
+        continue;
+      frame_lock (p);
+      p->pinned = false;
+      t->vmstat.locked--;
+      if (p->frame != NULL)
+        frame_unlock (p->frame);
+    }
+}
+
+/* Creates the page of a region containing ADDR if it is a
+   read-only file page, which another process may already have in
+   the shared page table; otherwise returns a null pointer.  Lets
+   fault-around reach text pages this process has not touched. */
+static struct spt_elem *
+page_from_region (const void *addr)
+{
+  struct region *r = region_find (addr);
+
+  if (r == NULL || !r->read_only
+      || (uint8_t *) addr - r->start >= r->length)
+    return NULL;
+  return region_get_page (r, addr);
+}
+
+/* Installs page Q in the current page directory if its data is
+   already in a frame, either Q's own or one shared by another
+   process, and that frame is not busy. */
+static void
+page_map_resident (struct spt_elem *q)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct frame *f = q->frame;
+
+  if (pagedir_get_page (pd, q->addr) != NULL)
+    return;
+
+  if (f != NULL)
+    {
+      if (!lock_try_acquire (&f->lock))
+        return;
+      if (f != q->frame)
+        {
+          lock_release (&f->lock);
+          return;
+        }
+    }
+  else if (page_is_shareable (q))
+    {
+      f = frame_share_try (q);
+      if (f == NULL)
+        return;
+      q->frame = f;
+      page_rss_add (q, 1);
+    }
+  else
+    return;
+
+  pagedir_set_page (pd, q->addr, f->base, !q->read_only && !q->cow);
+  frame_unlock (f);
+}
+
+/* Removes page P from its process's page directory, invalidating
+   its TLB entry at once if BATCH is null, otherwise when BATCH
+   ends. */
+static void
+page_unmap (struct spt_elem *p, struct pagedir_batch *batch)
+{
+  if (batch != NULL)
+    {
+      ASSERT (batch->pd == p->thread->pagedir);
+      pagedir_batch_clear (batch, p->addr);
+    }
+  else
+    pagedir_clear_page (p->thread->pagedir, p->addr);
+}
+
 /* Evicts page P.
    P must have a locked frame.
+   Clean pages backed by a file are just dropped, since they can
+   be read back.  Dirty memory-mapped pages are written back to
+   their file, and everything else goes to swap.
+   The page's TLB entry is invalidated at once if BATCH is null,
+   otherwise when BATCH ends.
    Return true if successful, false on failure. */
 int
-page_out (struct spt_elem *page){
+page_out (struct spt_elem *page, struct pagedir_batch *batch){
     struct frame *frame = page->frame;
-    struct thread * thread = page->thread;
-    pagedir_clear_page(thread->pagedir, page->addr);
-    
-    int s = (page->fileptr != (void *)0);
-    bool t = pagedir_is_dirty(thread->pagedir, page->addr);
-    int st= s*2+(int)t;
-    switch (st) {
-    case 0:
-        frame = (void *)0;
-        return true;
-        break;
-    case 1:
-        s = (page->writable) ? swap_out(page)
-                             : file_write_at(page->fileptr, frame->base, page->bytes, page->ofs) == page->bytes;
-        break;
-    case 2:
-        s = swap_out(page);
-        break;
-    case 3:
-        s = swap_out(page);
-        break;
-    };
-    if (s) {
-        frame = (void *)0;
-    }
-    return s;
+    struct thread *thread = page->thread;
+    bool dirty;
+    int ok;
+
+    /* Unmap first, so that the process cannot change the page
+       after we sample its dirty bit. */
+    page_unmap(page, batch);
+    dirty = pagedir_is_dirty(thread->pagedir, page->addr);
+
+    if (page->fileptr == NULL)
+        ok = swap_out(page);
+    else if (!dirty)
+        ok = true;
+    else if (page->writable)
+        ok = swap_out(page);
+    else
+        ok = file_write_at(page->fileptr, frame->base, page->bytes,
+                           page->ofs) == page->bytes;
+    if (ok)
+        page->frame = NULL;
+    return ok;
 };
 
 /* Returns true if page P's data has been accessed recently,
@@ -269,11 +667,12 @@ void
 page_exit (void){
     struct thread* t = thread_current();
     struct hash *h =t->pages;
-    if (h){
-        struct thread* tmp = thread_current();
-        tmp->nice = 0;
-    }else
+    if (h != NULL) {
         hash_destroy(h, page_destroy);
+        free(h);
+        t->pages = NULL;
+    }
+    region_destroy(&t->regions);
 };
 
 
@@ -284,10 +683,15 @@ page_destroy (struct hash_elem *tmp, void *aux){
   struct spt_elem *p = hash_entry (tmp, struct spt_elem, hash_elem);
   frame_lock (p);
   if (p->frame) {
-      frame_free(p->frame);
+      if (p->frame->ref_cnt > 0)
+          frame_share_release(p);
+      else
+          frame_free(p->frame);
       free(p);
-  } else
+  } else {
+      swap_discard(p);
       free(p);
+  }
 };
 /* Returns true if page A precedes page B. */
 bool 
@@ -304,7 +708,9 @@ page_hash (const struct hash_elem *e, void *aux UNUSED)
 }
 
 /* Tries to lock the page containing ADDR into physical memory.
-   If WILL_WRITE is true, the page must be writeable;
+   If WILL_WRITE is true, the page must be writeable, and a
+   copy-on-write page gets its private frame first, since a write
+   fault on a frame this thread has locked could not be handled;
    otherwise it may be read-only.
    Returns true if successful, false on failure. */
 int
@@ -313,12 +719,15 @@ page_lock (const void *addr, int will_write)
   struct spt_elem *p = page_for_addr (addr);
   if (p == NULL || (p->read_only && will_write))
     return false;
+  if (will_write && p->cow && !page_cow ((void *) addr))
+    return false;
   
   frame_lock (p);
   if (p->frame == NULL)
     return (page_get_in (p)
             && pagedir_set_page (thread_current ()->pagedir, p->addr,
-                                 p->frame->base, !p->read_only)); 
+                                 p->frame->base,
+                                 !p->read_only && !p->cow)); 
   else
     return true;
 }
@@ -333,26 +742,232 @@ page_unlock (const void *addr)
 }
 
 
+/* Copies PARENT's supplemental page table into the current
+   thread, which must have a page directory but no pages yet,
+   for fork().  Writable resident pages are not copied: the frame
+   is mapped read-only into both processes and split by
+   page_cow() on the first write.  Read-only pages are left to
+   be faulted in through the shared page table, and untouched
+   pages are described by the copied regions.  Memory-mapped
+   file pages are not inherited.  PARENT must be blocked
+   throughout.  Returns true if successful, false on failure. */
+bool
+page_fork (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  struct hash_iterator i;
+
+  t->pages = malloc (sizeof *t->pages);
+  if (t->pages == NULL)
+    return false;
+  hash_init (t->pages, page_hash, page_less, NULL);
+
+  hash_first (&i, parent->pages);
+  while (hash_next (&i))
+    {
+      struct spt_elem *pp = hash_entry (hash_cur (&i),
+                                        struct spt_elem, hash_elem);
+      struct region *r = region_lookup (&parent->regions, pp->addr);
+      struct spt_elem *cp;
+      struct frame *f;
+
+      /* Mapped file pages write back to their file.  Tell them by
+         their region, since swapping a page out also clears its
+         `writable'. */
+      if (r != NULL && !r->read_only && !r->writable)
+        continue;
+
+      cp = page_allocate (pp->addr, pp->read_only);
+      if (cp == NULL)
+        return false;
+      if (pp->fileptr != NULL)
+        {
+          cp->fileptr = pp->fileptr == parent->elffile
+                        ? t->elffile : pp->fileptr;
+          cp->ofs = pp->ofs;
+          cp->bytes = pp->bytes;
+        }
+      if (pp->read_only)
+        continue;
+
+      /* Pin the parent's page in memory.  A swapped-out page is
+         brought back in so that both processes can share it. */
+      frame_lock (pp);
+      if (pp->frame == NULL)
+        {
+          if (!swap_holds (pp))
+            continue;
+          if (!page_get_in (pp))
+            return false;
+          if (!pagedir_set_page (parent->pagedir, pp->addr,
+                                 pp->frame->base, true))
+            {
+              frame_unlock (pp->frame);
+              return false;
+            }
+        }
+
+      f = pp->frame;
+      if (f->ref_cnt == 0)
+        {
+          list_push_back (&f->sharers, &pp->share_elem);
+          f->ref_cnt = 1;
+        }
+      list_push_back (&f->sharers, &cp->share_elem);
+      f->ref_cnt++;
+      cp->frame = f;
+      page_rss_add (cp, 1);
+      pp->cow = cp->cow = true;
+      pagedir_set_writable (parent->pagedir, pp->addr, false);
+      if (!pagedir_set_page (t->pagedir, cp->addr, f->base, false))
+        {
+          frame_unlock (f);
+          return false;
+        }
+
+      /* Eviction writes the frame back only if some sharer's PTE
+         is dirty, and the parent's may be gone by then. */
+      if (pagedir_is_dirty (parent->pagedir, pp->addr))
+        pagedir_set_dirty (t->pagedir, cp->addr, true);
+      frame_unlock (f);
+    }
+
+  /* Pages the parent never touched. */
+  return region_fork (parent);
+}
+
+/* Resolves a write fault on FAULT_ADDR if it hits a copy-on-write
+   page.  The faulting process gets a private copy of the frame,
+   or, if it is the frame's last user, the frame itself is made
+   writable again.  A page mapped to the zero page gets a frame of
+   its own.  Returns true if the fault was handled, false if
+   FAULT_ADDR is not a copy-on-write page. */
+bool
+page_cow (void *fault_addr)
+{
+  struct thread *t = thread_current ();
+  struct spt_elem *p = page_find (fault_addr);
+  struct frame *f;
+
+  if (p != NULL && !p->read_only && p->frame == NULL
+      && pagedir_get_page (t->pagedir, p->addr) == zero_page)
+    return page_in (fault_addr, true);
+  if (p == NULL || !p->cow)
+    return false;
+
+  frame_lock (p);
+  f = p->frame;
+  p->cow = false;
+  page_count_fault (p, false);
+  if (f == NULL)
+    {
+      /* Evicted meanwhile: the next fault brings in a private,
+         writable copy. */
+      return true;
+    }
+
+  list_remove (&p->share_elem);
+  if (--f->ref_cnt > 0)
+    {
+      struct frame *copy = frame_alloc (p);
+      if (copy == NULL)
+        {
+          list_push_back (&f->sharers, &p->share_elem);
+          f->ref_cnt++;
+          p->cow = true;
+          frame_unlock (f);
+          return false;
+        }
+      memcpy (copy->base, f->base, PGSIZE);
+      if (f->page == p)
+        f->page = list_entry (list_front (&f->sharers),
+                              struct spt_elem, share_elem);
+      frame_unlock (f);
+
+      p->frame = copy;
+      pagedir_clear_page (t->pagedir, p->addr);
+      pagedir_set_page (t->pagedir, p->addr, copy->base, true);
+      f = copy;
+    }
+  else
+    {
+      /* Last user of the frame: keep it. */
+      f->page = p;
+      pagedir_set_writable (t->pagedir, p->addr, true);
+    }
+
+  /* The data may differ from any backing file. */
+  pagedir_set_dirty (t->pagedir, p->addr, true);
+  frame_unlock (f);
+  return true;
+}
+
+/* Returns true if page P is anonymous and holds nothing yet, so
+   that its contents are all zeros. */
+static bool
+page_is_zero (const struct spt_elem *p)
+{
+  return p->frame == NULL && p->fileptr == NULL && !swap_holds (p);
+}
+
+/* Returns true if page P may share its frame with the same page
+   of other processes: it is read-only and still backed by its
+   file. */
+static bool
+page_is_shareable (const struct spt_elem *p)
+{
+  return p->read_only && p->fileptr != NULL
+         && !swap_holds (p);
+}
+
 /* Locks a frame for page P and pages it in.
    Returns true if successful, false on failure. */
 int
 page_get_in (struct spt_elem *p)
 {
-  /* Get a frame for the page. */
-  p->frame = frame_alloc(p);
+  /* Get a frame for the page.  Read-only file pages (program
+     text and rodata) may already be in memory for another
+     process, in which case there is nothing to read. */
+  if (page_is_shareable (p))
+    {
+      bool loaded;
+      p->frame = frame_share_alloc (p, &loaded);
+      if (p->frame != NULL)
+        page_rss_add (p, 1);
+      if (p->frame != NULL && loaded)
+        {
+          page_count_fault (p, false);
+          return 1;
+        }
+    }
+  else
+    {
+      p->frame = frame_alloc(p);
+      if (p->frame != NULL)
+        page_rss_add (p, 1);
+    }
 
   if (p->frame == NULL)
       return 0;
-  int st = (int)(p->sector != (block_sector_t)-1)*2 + (int) ((p->fileptr != NULL));
+  page_count_fault (p, p->fileptr != NULL || swap_holds (p));
+  if (swap_holds (p))
+    p->thread->vmstat.swap_ins++;
+  int st = (int)swap_holds(p)*2 + (int) ((p->fileptr != NULL));
   
   switch(st){
       case 0:
+        /* Replaces the zero page, if the page was read before. */
+        if (pagedir_get_page (p->thread->pagedir, p->addr) == zero_page)
+          pagedir_clear_page (p->thread->pagedir, p->addr);
         memset(p->frame->base, 0, PGSIZE);
         break;
       case 1:
-        /* Get data from file. */
-        memset(p->frame->base + (off_t)file_read_at(p->fileptr, p->frame->base, p->bytes, p->ofs), 0,
-             (off_t)(PGSIZE - file_read_at(p->fileptr, p->frame->base, p->bytes, p->ofs)));
+        /* Get data from file, then zero the tail of the page. */
+        {
+          off_t read_bytes = file_read_at (p->fileptr, p->frame->base,
+                                           p->bytes, p->ofs);
+          memset (p->frame->base + read_bytes, 0, PGSIZE - read_bytes);
+        }
         break;
       case 2:
         swap_in(p);
@@ -366,3 +981,55 @@ page_get_in (struct spt_elem *p)
 }
 
 
+
+/* Counts a page fault on P, a major one if MAJOR is true. */
+static void
+page_count_fault (struct spt_elem *p, bool major)
+{
+  struct vmstat *s = &p->thread->vmstat;
+  enum intr_level old_level = intr_disable ();
+  if (major)
+    s->major_faults++;
+  else
+    s->minor_faults++;
+  intr_set_level (old_level);
+}
+
+/* Adds DELTA to the resident set size of P's process.  The
+   counters of a process are also updated by other processes
+   evicting its pages, hence the disabled interrupts. */
+void
+page_rss_add (struct spt_elem *p, int delta)
+{
+  struct vmstat *s = &p->thread->vmstat;
+  enum intr_level old_level = intr_disable ();
+  s->rss += delta;
+  if (s->rss > s->peak_rss)
+    s->peak_rss = s->rss;
+  intr_set_level (old_level);
+}
+
+/* Records that page P has just lost its frame to eviction. */
+void
+page_evicted (struct spt_elem *p)
+{
+  struct vmstat *s = &p->thread->vmstat;
+  enum intr_level old_level = intr_disable ();
+  s->rss--;
+  s->evictions++;
+  intr_set_level (old_level);
+}
+
+/* Prints the current process's virtual memory statistics if the
+   "-vmstat" option is set. */
+void
+page_print_stats (void)
+{
+  struct vmstat *s = &thread_process ()->vmstat;
+
+  if (page_print_vmstat)
+    printf ("%s: vmstat: %d minor, %d major faults, %d evictions, "
+            "%d swap-ins, rss %d, peak rss %d\n", thread_name (),
+            s->minor_faults, s->major_faults, s->evictions, s->swap_ins,
+            s->rss, s->peak_rss);
+}
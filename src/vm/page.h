@@ -5,6 +5,7 @@
 #include "devices/block.h"
 #include "filesys/off_t.h"
 #include "threads/synch.h"
+#include "userprog/pagedir.h"
 
 /* Virtual page. */
 struct spt_elem 
@@ -12,6 +13,10 @@ struct spt_elem
     /* Immutable members. */
     void *addr;                 /* User virtual address. */
     bool read_only;             /* Read-only page? */
+    bool cow;                   /* Mapped read-only until first write,
+                                   sharing its frame after fork(). */
+    bool pinned;                /* Locked in memory by mlock()?
+                                   Changed with frame->frame_lock held. */
     struct thread *thread;      /* Owning thread. */
     uint8_t *upage;             /* The page the descrpting. */
 
@@ -23,6 +28,9 @@ struct spt_elem
 
     /* Swap information, protected by frame->frame_lock. */
     block_sector_t sector;       /* Starting sector of swap area, or -1. */
+    size_t zslot;                /* First chunk in compressed swap pool,
+                                    or BITMAP_ERROR. */
+    uint16_t zbytes;             /* Compressed size in the pool. */
     
     /* Memory-mapped file information, protected by frame->frame_lock. */
     bool writable;               /* False to write back to file,
@@ -32,23 +40,40 @@ struct spt_elem
     off_t bytes;               /* Bytes to read/write, 1...PGSIZE. */
     struct hash_elem hash_elem;  /* struct thread `pages' hash element. */
     struct list_elem slot_elem;     /* Swap slot */
+    struct list_elem share_elem;    /* struct frame `sharers' element. */
   };
 
 
+/* Fault-around window, in pages on each side of a fault. */
+extern int page_fault_around_pages;
+extern bool page_print_vmstat;
+extern int page_mlock_limit;
 
+void page_init (void);
 void page_exit (void);
+void page_rss_add (struct spt_elem *, int delta);
+void page_evicted (struct spt_elem *);
+void page_print_stats (void);
 struct spt_elem *page_allocate (void *, int read_only);
-struct spt_elem *page_find (void *upage);
-void page_deallocate (void *vaddr);
-int page_in (void *fault_addr);
+struct spt_elem *page_find (const void *upage);
+bool page_table_acquire (void);
+void page_table_release (bool acquired);
+void page_deallocate (void *vaddr, struct pagedir_batch *);
+void page_prefetch (const void *addr);
+bool page_madvise (uint8_t *start, uint8_t *end, int advice);
+bool page_mlock (uint8_t *start, uint8_t *end);
+void page_munlock (uint8_t *start, uint8_t *end);
+int page_in (void *fault_addr, bool write);
 int page_get_in (struct spt_elem *p);
-int page_out (struct spt_elem *);
+int page_out (struct spt_elem *, struct pagedir_batch *);
 int page_get_recently (struct spt_elem *);
 int page_lock (const void *, int will_write);
 void page_unlock (const void *);
 void page_destroy (struct hash_elem *tmp, void *aux);
 struct spt_elem *page_get_addr (const void *address);
 bool page_validate (struct spt_elem *page, bool will_write);
+bool page_fork (struct thread *parent);
+bool page_cow (void *fault_addr);
 hash_hash_func page_hash;
 hash_less_func page_less;
 
@@ -0,0 +1,231 @@
+#include "vm/region.h"
+#include <debug.h>
+#include <madvise.h>
+#include <string.h>
+#include "vm/page.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+static struct region *region_insert (struct region_table *,
+                                     uint8_t *start, uint8_t *end,
+                                     struct file *, off_t ofs,
+                                     off_t length, bool read_only,
+                                     bool writable);
+static size_t region_search (const struct region_table *, const void *);
+
+/* Initializes TABLE as an empty region table. */
+void
+region_init (struct region_table *table)
+{
+  table->regions = NULL;
+  table->cnt = 0;
+  table->cap = 0;
+}
+
+/* Adds a region of PAGE_CNT pages starting at START to the
+   current process.  The first LENGTH bytes come from FILE
+   starting at offset OFS, the rest are zeroed; FILE may be null
+   for an entirely zero-filled region.  Fails if the range wraps,
+   leaves user space, or overlaps another region or an existing
+   page.  Returns the new region, or a null pointer on failure. */
+struct region *
+region_add (uint8_t *start, size_t page_cnt, struct file *file,
+            off_t ofs, off_t length, bool read_only, bool writable)
+{
+  uint8_t *end = start + page_cnt * PGSIZE;
+  uint8_t *upage;
+  struct region *r;
+  bool locked;
+
+  ASSERT (pg_ofs (start) == 0);
+  if (page_cnt == 0 || end <= start || end > (uint8_t *) PHYS_BASE)
+    return NULL;
+  locked = page_table_acquire ();
+  for (upage = start; upage < end; upage += PGSIZE)
+    if (page_find (upage) != NULL)
+      {
+        page_table_release (locked);
+        return NULL;
+      }
+  r = region_insert (&thread_process ()->regions, start, end, file,
+                     ofs, length, read_only, writable);
+  page_table_release (locked);
+  return r;
+}
+
+/* Returns the current process's region containing ADDR, or a
+   null pointer if there is none. */
+struct region *
+region_find (const void *addr)
+{
+  bool locked = page_table_acquire ();
+  struct region *r = region_lookup (&thread_process ()->regions, addr);
+
+  page_table_release (locked);
+  return r;
+}
+
+/* Returns the region of TABLE containing ADDR, or a null pointer
+   if there is none.  The caller must keep TABLE from changing. */
+struct region *
+region_lookup (const struct region_table *table, const void *addr)
+{
+  size_t idx = region_search (table, addr);
+
+  if (idx < table->cnt && table->regions[idx]->start <= (uint8_t *) addr)
+    return table->regions[idx];
+  return NULL;
+}
+
+/* Removes region R from the current process and frees it.  Pages
+   already created for R are not affected. */
+void
+region_remove (struct region *r)
+{
+  struct region_table *table = &thread_process ()->regions;
+  bool locked = page_table_acquire ();
+  size_t idx = region_search (table, r->start);
+
+  ASSERT (idx < table->cnt && table->regions[idx] == r);
+  memmove (table->regions + idx, table->regions + idx + 1,
+           (table->cnt - idx - 1) * sizeof *table->regions);
+  table->cnt--;
+  page_table_release (locked);
+  free (r);
+}
+
+/* Frees every region in TABLE. */
+void
+region_destroy (struct region_table *table)
+{
+  size_t i;
+
+  for (i = 0; i < table->cnt; i++)
+    free (table->regions[i]);
+  free (table->regions);
+  region_init (table);
+}
+
+/* Copies PARENT's regions into the current process, for fork().
+   Regions of the parent's executable are redirected to the
+   current process's own handle on it.  Memory-mapped files are
+   not inherited.  Returns true if successful, false if memory
+   allocation fails. */
+bool
+region_fork (struct thread *parent)
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  region_init (&t->regions);
+  for (i = 0; i < parent->regions.cnt; i++)
+    {
+      struct region *r = parent->regions.regions[i];
+      struct file *file = r->file == parent->elffile ? t->elffile : r->file;
+      struct region *copy;
+
+      if (!r->read_only && !r->writable)
+        continue;
+      copy = region_insert (&t->regions, r->start, r->end, file, r->ofs,
+                            r->length, r->read_only, r->writable);
+      if (copy == NULL)
+        return false;
+      copy->advice = r->advice;
+    }
+  return true;
+}
+
+/* Creates the page of region R that contains ADDR, which has not
+   been touched before, in the current process's page table.
+   Returns the new page, or a null pointer if memory allocation
+   fails. */
+struct spt_elem *
+region_get_page (struct region *r, const void *addr)
+{
+  uint8_t *upage = pg_round_down (addr);
+  off_t pos = upage - r->start;
+  struct spt_elem *p;
+  bool locked;
+
+  ASSERT (r->start <= upage && upage < r->end);
+
+  /* Fill P in before another thread of the process can find it. */
+  locked = page_table_acquire ();
+  p = page_allocate (upage, r->read_only);
+  if (p != NULL)
+    {
+      p->writable = r->writable;
+      if (pos < r->length)
+        {
+          p->fileptr = r->file;
+          p->ofs = r->ofs + pos;
+          p->bytes = r->length - pos < PGSIZE ? r->length - pos : PGSIZE;
+        }
+    }
+  page_table_release (locked);
+  return p;
+}
+
+/* Adds a region spanning START...END to TABLE, keeping TABLE
+   sorted by address.  Fails if it overlaps a region already in
+   TABLE.  Returns the new region, or a null pointer on failure. */
+static struct region *
+region_insert (struct region_table *table, uint8_t *start, uint8_t *end,
+               struct file *file, off_t ofs, off_t length,
+               bool read_only, bool writable)
+{
+  size_t idx = region_search (table, start);
+  struct region *r;
+
+  if (idx < table->cnt && table->regions[idx]->start < end)
+    return NULL;
+
+  if (table->cnt == table->cap)
+    {
+      size_t cap = table->cap > 0 ? table->cap * 2 : 8;
+      struct region **regions = realloc (table->regions,
+                                         cap * sizeof *regions);
+      if (regions == NULL)
+        return NULL;
+      table->regions = regions;
+      table->cap = cap;
+    }
+
+  r = malloc (sizeof *r);
+  if (r == NULL)
+    return NULL;
+  r->start = start;
+  r->end = end;
+  r->file = file;
+  r->ofs = ofs;
+  r->length = file != NULL ? length : 0;
+  r->read_only = read_only;
+  r->writable = writable;
+  r->advice = MADV_NORMAL;
+
+  memmove (table->regions + idx + 1, table->regions + idx,
+           (table->cnt - idx) * sizeof *table->regions);
+  table->regions[idx] = r;
+  table->cnt++;
+  return r;
+}
+
+/* Returns the index of the first region in TABLE that ends above
+   ADDR, which is the region containing ADDR if there is one, or
+   else where a region starting at ADDR belongs. */
+static size_t
+region_search (const struct region_table *table, const void *addr)
+{
+  size_t lo = 0, hi = table->cnt;
+
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if ((const uint8_t *) addr < table->regions[mid]->end)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+  return lo;
+}
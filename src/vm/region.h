@@ -0,0 +1,52 @@
+#ifndef VM_REGION_H
+#define VM_REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct spt_elem;
+struct thread;
+
+/* A contiguous range of a process's virtual address space whose
+   pages share the same backing and protection: an ELF segment or
+   a memory-mapped file.  Pages of a region get a struct spt_elem
+   only when they are first touched, so a region costs one
+   allocation however large it is. */
+struct region
+  {
+    uint8_t *start;             /* First page. */
+    uint8_t *end;               /* One past the last page. */
+    struct file *file;          /* Backing file, or null. */
+    off_t ofs;                  /* Offset of START in FILE. */
+    off_t length;               /* Bytes of FILE data from START;
+                                   the rest is zero-filled. */
+    bool read_only;             /* Read-only pages? */
+    bool writable;              /* As spt_elem `writable': false to
+                                   write back to FILE. */
+    int advice;                 /* MADV_NORMAL, MADV_SEQUENTIAL, or
+                                   MADV_RANDOM. */
+  };
+
+/* A process's regions, sorted by address, so that the region
+   containing an address is found by binary search. */
+struct region_table
+  {
+    struct region **regions;    /* Sorted by START. */
+    size_t cnt;                 /* Number of regions. */
+    size_t cap;                 /* Allocated slots. */
+  };
+
+void region_init (struct region_table *);
+struct region *region_add (uint8_t *start, size_t page_cnt,
+                           struct file *, off_t ofs, off_t length,
+                           bool read_only, bool writable);
+struct region *region_find (const void *addr);
+struct region *region_lookup (const struct region_table *, const void *addr);
+void region_remove (struct region *);
+void region_destroy (struct region_table *);
+bool region_fork (struct thread *parent);
+struct spt_elem *region_get_page (struct region *, const void *addr);
+
+#endif /* vm/region.h */
@@ -1,72 +1,327 @@
 #include "vm/swap.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
+/* Number of sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* Size of an allocation unit in the compressed pool. */
+#define CHUNK_SIZE 64
+
+/* Pages that do not compress to this size or less go straight
+   to the swap device. */
+#define MAX_COMPRESSED (PGSIZE - PGSIZE / 4)
+
+/* Pages of memory given to the compressed pool, set by the "-zs"
+   kernel command-line option; 0 disables the pool, and a negative
+   value sizes it from the amount of RAM. */
+int swap_pool_pages = -1;
+
 static struct block *device;
 static struct bitmap *swapped_location;
 static struct lock swap_lock;
 
+/* Compressed pool, protected by swap_lock. */
+static uint8_t *pool;                   /* Pool memory. */
+static struct bitmap *pool_map;         /* Used chunks of POOL. */
+
+/* Compressor state, protected by swap_lock. */
+static uint8_t zbuf[MAX_COMPRESSED];    /* Compressor output. */
+static uint16_t lz_table[4096];         /* Recent positions by hash. */
+
+/* Statistics, protected by swap_lock. */
+static long long pool_outs;             /* Pages stored in the pool. */
+static long long pool_bytes;            /* Their compressed size. */
+static long long pool_ins;              /* Pages read back from pool. */
+static long long disk_outs;             /* Pages written to disk. */
+static long long disk_ins;              /* Pages read from disk. */
+
+static void pool_init (void);
+static size_t lz_compress (const uint8_t *, uint8_t *, size_t max);
+static void lz_decompress (const uint8_t *, size_t, uint8_t *);
+
 /* Sets up swap. */
 void
-swap_init (void) 
+swap_init (void)
 {
   device = block_get_role (BLOCK_SWAP);
       swapped_location =  (device == NULL) ?bitmap_create (0):bitmap_create (block_size (device)
-                                 / PGSIZE * BLOCK_SECTOR_SIZE);
+                                 / PAGE_SECTORS);
   int test =swapped_location == NULL;
   switch (4 * test) {
   case 4:
       PANIC("SB swap bitmap");
   }
   lock_init (&swap_lock);
+  lock_register (&swap_lock, "swap");
+  pool_init ();
+}
+
+/* Carves the compressed pool out of the user pool.  Must run
+   before frame_init() takes the remaining user pages. */
+static void
+pool_init (void)
+{
+  size_t page_cnt = swap_pool_pages >= 0 ? (size_t) swap_pool_pages
+                                         : init_ram_pages / 16;
+
+  /* Take the largest contiguous run we can get. */
+  for (; page_cnt > 0; page_cnt /= 2)
+    {
+      pool = palloc_get_multiple (PAL_USER, page_cnt);
+      if (pool != NULL)
+        break;
+    }
+  if (pool == NULL)
+    return;
+
+  pool_map = bitmap_create (page_cnt * PGSIZE / CHUNK_SIZE);
+  if (pool_map == NULL)
+    {
+      palloc_free_multiple (pool, page_cnt);
+      pool = NULL;
+      return;
+    }
+  printf ("swap: %zu pages of compressed swap pool\n", page_cnt);
+}
+
+/* Returns true if page P is swapped out, either to the
+   compressed pool or to the swap device. */
+bool
+swap_holds (const struct spt_elem *p)
+{
+  return p->zslot != BITMAP_ERROR || p->sector != (block_sector_t) -1;
 }
 
 /* Swaps in page P, which must have a locked frame
    (and be swapped out). */
 void
-swap_in (struct spt_elem *p) 
+swap_in (struct spt_elem *p)
 {
     uint32_t i = 0;
 
-    while (i < PGSIZE / BLOCK_SECTOR_SIZE) {
+    if (p->zslot != BITMAP_ERROR) {
+        /* The chunks belong to P until they are released below. */
+        lz_decompress (pool + p->zslot * CHUNK_SIZE, p->zbytes,
+                       p->frame->base);
+        lock_acquire (&swap_lock);
+        bitmap_set_multiple (pool_map, p->zslot,
+                             DIV_ROUND_UP (p->zbytes, CHUNK_SIZE), false);
+        pool_ins++;
+        lock_release (&swap_lock);
+        p->zslot = BITMAP_ERROR;
+        return;
+    }
+
+    while (i < PAGE_SECTORS) {
         block_read(device, p->sector + i, p->frame->base + i * BLOCK_SECTOR_SIZE);
         i++;
     }
-    bitmap_reset(swapped_location, p->sector / PGSIZE * BLOCK_SECTOR_SIZE);
+    lock_acquire (&swap_lock);
+    bitmap_reset(swapped_location, p->sector / PAGE_SECTORS);
+    disk_ins++;
+    lock_release (&swap_lock);
     p->sector = (block_sector_t)-1;
 }
 
-/* Swaps out page P, which must have a locked frame. */
+/* Swaps out page P, which must have a locked frame.  The page is
+   compressed into the pool if it fits, and written to the swap
+   device otherwise. */
 int
-swap_out (struct spt_elem *p) 
+swap_out (struct spt_elem *p)
 {
   uint32_t slot;
   uint32_t i = 0;
 
   lock_acquire (&swap_lock);
+  if (pool != NULL)
+    {
+      size_t size = lz_compress (p->frame->base, zbuf, sizeof zbuf);
+      slot = size > 0
+             ? bitmap_scan_and_flip (pool_map, 0,
+                                     DIV_ROUND_UP (size, CHUNK_SIZE), false)
+             : BITMAP_ERROR;
+      if (slot != BITMAP_ERROR)
+        {
+          memcpy (pool + slot * CHUNK_SIZE, zbuf, size);
+          pool_outs++;
+          pool_bytes += size;
+          lock_release (&swap_lock);
+          p->zslot = slot;
+          p->zbytes = size;
+          goto done;
+        }
+    }
   slot = bitmap_scan_and_flip (swapped_location, 0, 1, false);
+  if (slot != BITMAP_ERROR)
+    disk_outs++;
   lock_release (&swap_lock);
   int te=slot == BITMAP_ERROR;
   switch (te*4){
   case 4:
-      return 0; 
-  } 
+      return 0;
+  }
 
-  p->sector = slot * PGSIZE / BLOCK_SECTOR_SIZE;
+  p->sector = slot * PAGE_SECTORS;
 
-  while(i < PGSIZE / BLOCK_SECTOR_SIZE){
+  while(i < PAGE_SECTORS){
      block_write (device, p->sector + i, p->frame->base + i * BLOCK_SECTOR_SIZE);
      i++;
-  } 
+  }
+ done:
   p->writable = false;
   p->fileptr = NULL;
   p->ofs = 0;
   p->bytes = 0;
 
   return 1;
-}
\ No newline at end of file
+}
+
+/* Releases the swap space held by page P, which is being
+   destroyed without being swapped back in. */
+void
+swap_discard (struct spt_elem *p)
+{
+  lock_acquire (&swap_lock);
+  if (p->zslot != BITMAP_ERROR)
+    bitmap_set_multiple (pool_map, p->zslot,
+                         DIV_ROUND_UP (p->zbytes, CHUNK_SIZE), false);
+  else if (p->sector != (block_sector_t) -1)
+    bitmap_reset (swapped_location, p->sector / PAGE_SECTORS);
+  lock_release (&swap_lock);
+  p->zslot = BITMAP_ERROR;
+  p->sector = (block_sector_t) -1;
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  if (pool_outs + disk_outs == 0)
+    return;
+  printf ("Swap: %lld pages compressed to %lld%%, %lld to disk; "
+          "%lld disk writes and %lld disk reads avoided\n",
+          pool_outs, pool_outs > 0 ? pool_bytes * 100 / (pool_outs * PGSIZE)
+                                   : 0,
+          disk_outs, pool_outs, pool_ins);
+}
+
+/* Compressed pages are a sequence of groups, each a control byte
+   followed by 8 items.  Bit N of the control byte, starting from
+   the least significant, says whether item N is a literal byte
+   (0) or a back-reference (1).  A back-reference is 2 bytes: a
+   12-bit distance to copy from, 1...4095 bytes back, and a 4-bit
+   length code for 3...17 bytes, or 15 for 18 bytes plus the
+   value of a third byte. */
+
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15 + 255)
+#define LZ_MAX_DIST 4095
+
+/* Returns a hash of the 3 bytes at P, for indexing lz_table. */
+static inline unsigned
+lz_hash (const uint8_t *p)
+{
+  return ((p[0] << 8 ^ p[1] << 4 ^ p[2]) * 2654435761u) >> 20;
+}
+
+/* Compresses the page at SRC into DST.  Returns the compressed
+   size, or 0 if it would exceed MAX bytes.  lz_table holds
+   positions from earlier calls, which is harmless because every
+   candidate match is verified. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t max)
+{
+  size_t pos = 0, out = 0;
+  size_t ctrl = 0;
+  int bit = 8;
+
+  while (pos < PGSIZE)
+    {
+      size_t cand = 0, len = 0;
+
+      /* Room for a new control byte and the largest item. */
+      if (out + 4 > max)
+        return 0;
+      if (bit == 8)
+        {
+          ctrl = out++;
+          dst[ctrl] = 0;
+          bit = 0;
+        }
+
+      if (pos + LZ_MIN_MATCH <= PGSIZE)
+        {
+          unsigned h = lz_hash (src + pos);
+          cand = lz_table[h];
+          lz_table[h] = pos;
+          if (cand < pos && pos - cand <= LZ_MAX_DIST)
+            {
+              size_t limit = PGSIZE - pos < LZ_MAX_MATCH
+                             ? PGSIZE - pos : LZ_MAX_MATCH;
+              while (len < limit && src[cand + len] == src[pos + len])
+                len++;
+            }
+        }
+
+      if (len >= LZ_MIN_MATCH)
+        {
+          size_t dist = pos - cand;
+          size_t code = len - LZ_MIN_MATCH < 15 ? len - LZ_MIN_MATCH : 15;
+
+          dst[ctrl] |= 1 << bit;
+          dst[out++] = dist & 0xff;
+          dst[out++] = (dist >> 8) | (code << 4);
+          if (code == 15)
+            dst[out++] = len - LZ_MIN_MATCH - 15;
+          pos += len;
+        }
+      else
+        dst[out++] = src[pos++];
+      bit++;
+    }
+  return out;
+}
+
+/* Decompresses the SIZE bytes at SRC, produced by lz_compress(),
+   into the page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst)
+{
+  const uint8_t *end = src + size;
+  size_t pos = 0;
+
+  while (src < end)
+    {
+      uint8_t ctrl = *src++;
+      int bit;
+
+      for (bit = 0; bit < 8 && src < end; bit++)
+        if (ctrl & (1 << bit))
+          {
+            size_t dist = src[0] | (src[1] & 0x0f) << 8;
+            size_t len = (src[1] >> 4) + LZ_MIN_MATCH;
+
+            src += 2;
+            if (len == LZ_MIN_MATCH + 15)
+              len += *src++;
+            ASSERT (dist > 0 && dist <= pos && pos + len <= PGSIZE);
+
+            /* Byte by byte, since the source may overlap. */
+            for (; len > 0; len--, pos++)
+              dst[pos] = dst[pos - dist];
+          }
+        else
+          dst[pos++] = *src++;
+    }
+  ASSERT (pos == PGSIZE);
+}
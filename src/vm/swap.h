@@ -2,8 +2,14 @@
 #define VM_SWAP_H 1
 
 #include "vm/page.h"
+
+extern int swap_pool_pages;
+
 void swap_init (void);
+bool swap_holds (const struct spt_elem *);
 void swap_in (struct spt_elem *);
 int swap_out (struct spt_elem *);
+void swap_discard (struct spt_elem *);
+void swap_print_stats (void);
 
 #endif /* vm/swap.h */
\ No newline at end of file